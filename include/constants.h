@@ -1,7 +1,22 @@
 #ifndef CONSTANTS_H
 #define CONSTANTS_H
 
+// Digest index of krnl_dedup - keep in sync with include_host/constants.h
+#define DEDUP_WAYS 4                                    // entries per bucket, clock eviction within a bucket
+#define DEDUP_BUCKETS 4096                              // power of 2
+#define DEDUP_SLOTS (DEDUP_BUCKETS * DEDUP_WAYS)
+#define DEDUP_HAND_BASE (2 * DEDUP_SLOTS)               // index layout: [digest, meta] per slot, then one clock hand per bucket
+#define DEDUP_INDEX_WORDS (DEDUP_HAND_BASE + DEDUP_BUCKETS)
+#define DEDUP_META_VALID 1ULL
+#define DEDUP_META_REF 2ULL
+#define DEDUP_SEEN_FLAG 0x80000000U                     // flags[m]: seen before | slot
+#define DEDUP_OP_LOOKUP 0
+#define DEDUP_OP_CLEAR 1
 
+// krnl_copy - keep in sync with include_host/constants.h
+#define COPY_MAX_WORDS 512                              // longest message (in words) that can be verified before it is written
+#define COPY_OK 0
+#define COPY_MISMATCH 1                                 // digest != expected, nothing written
+#define COPY_TOO_LONG 2                                 // verify requested but longer than COPY_MAX_WORDS, nothing written
 
-
-#endif
\ No newline at end of file
+#endif
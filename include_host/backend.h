@@ -0,0 +1,137 @@
+#ifndef BACKEND_H
+#define BACKEND_H
+
+#include "host.h"
+#include "xxhash64.h"
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
+
+/* Word ranges of a region a batch reads, written to its device buffer with as few transfers as possible
+add() every message, write() sorts them and sends each run of overlapping or adjacent ranges once -
+messages that repeat a payload cost no extra transfer
+*/
+struct word_ranges {
+    std::vector<std::pair<size_t, size_t> > ranges;
+
+    void clear() { ranges.clear(); }
+
+    void add(size_t begin, size_t end) {
+        if (end > begin) ranges.push_back(std::make_pair(begin, end));
+    }
+
+    void write(cl::CommandQueue& q, cl::Buffer& buffer, const uint64_t* region) {
+        cl_int err;
+        std::sort(ranges.begin(), ranges.end());
+        for (size_t i = 0; i < ranges.size();) {
+            size_t begin = ranges[i].first, end = ranges[i].second;
+            for (++i; i < ranges.size() && ranges[i].first <= end; ++i) {
+                end = std::max(end, ranges[i].second);
+            }
+            OCL_CHECK(err, err = q.enqueueWriteBuffer(buffer, CL_FALSE, begin * sizeof(uint64_t), (end - begin) * sizeof(uint64_t), region + begin));
+        }
+        ranges.clear();
+    }
+};
+
+/* A backend hashes a batch of messages that live in one registered memory region.
+message i is lengths[i] bytes long and starts at word offsets[i] of the region - same layout krnl takes
+*/
+
+struct hash_backend {
+    virtual ~hash_backend() {}
+    virtual const char* name() const = 0;
+    virtual void hash_batch(const uint64_t* offsets, const uint64_t* lengths, uint64_t* digests, size_t num_msgs) = 0;
+};
+
+// Software stand-in for the card - runs the host reference, lets everything run on a box without a device
+struct cpu_backend : hash_backend {
+    const uint64_t* region;
+
+    cpu_backend(const uint64_t* region) : region(region) {}
+
+    const char* name() const { return "cpu"; }
+
+    void hash_batch(const uint64_t* offsets, const uint64_t* lengths, uint64_t* digests, size_t num_msgs) {
+        for (size_t i = 0; i < num_msgs; ++i) {
+            digests[i] = XXHash64::hash(region + offsets[i], lengths[i], 0);
+        }
+    }
+};
+
+/* Runs batches through krnl
+The region is registered with the device once (CL_MEM_USE_HOST_PTR), so it has to be 4096 byte aligned.
+Per batch only the words that are actually hashed are written to the device, straight out of the region -
+adjacent messages are coalesced into one transfer. There is no staging copy on the host.
+*/
+struct device_backend : hash_backend {
+    cl::CommandQueue q;
+    cl::Kernel krnl;
+    uint64_t* region;
+    size_t max_batch;
+
+    std::vector<uint64_t, aligned_allocator<uint64_t> > offsets, lengths, digests;
+    cl::Buffer buffer_region, buffer_offsets, buffer_lengths, buffer_output;
+
+    device_backend(cl::Context& context, cl::CommandQueue& q, cl::Program& program, uint64_t* region, size_t region_bytes, size_t max_batch)
+        : q(q), region(region), max_batch(max_batch), offsets(max_batch), lengths(max_batch), digests(max_batch) {
+        cl_int err;
+        OCL_CHECK(err, krnl = cl::Kernel(program, "krnl", &err));
+        OCL_CHECK(err, buffer_region = cl::Buffer(context, CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY, region_bytes, region, &err));
+        OCL_CHECK(err, buffer_offsets = cl::Buffer(context, CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY, sizeof(uint64_t) * max_batch, offsets.data(), &err));
+        OCL_CHECK(err, buffer_lengths = cl::Buffer(context, CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY, sizeof(uint64_t) * max_batch, lengths.data(), &err));
+        OCL_CHECK(err, buffer_output = cl::Buffer(context, CL_MEM_USE_HOST_PTR | CL_MEM_WRITE_ONLY, sizeof(uint64_t) * max_batch, digests.data(), &err));
+
+        OCL_CHECK(err, err = krnl.setArg(0, buffer_region));
+        OCL_CHECK(err, err = krnl.setArg(1, buffer_offsets));
+        OCL_CHECK(err, err = krnl.setArg(2, buffer_lengths));
+        OCL_CHECK(err, err = krnl.setArg(3, buffer_output));
+    }
+
+    const char* name() const { return "device"; }
+
+    void write_words(size_t begin, size_t end) {
+        cl_int err;
+        if (end <= begin) return;
+        OCL_CHECK(err, err = q.enqueueWriteBuffer(buffer_region, CL_FALSE, begin * sizeof(uint64_t),
+                                                  (end - begin) * sizeof(uint64_t), region + begin));
+    }
+
+    void hash_batch(const uint64_t* offs, const uint64_t* lens, uint64_t* out, size_t num_msgs) {
+        cl_int err;
+        for (size_t first = 0; first < num_msgs; first += max_batch) {
+            size_t n = (num_msgs - first < max_batch) ? num_msgs - first : max_batch;
+
+            /* HOST -> DEVICE: payload words, coalescing messages that sit next to each other */
+            size_t run_begin = 0, run_end = 0;
+            for (size_t i = 0; i < n; ++i) {
+                offsets[i] = offs[first + i];
+                lengths[i] = lens[first + i];
+                size_t begin = offsets[i];
+                size_t end = begin + (lengths[i] + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+                if (begin != run_end) {
+                    write_words(run_begin, run_end);
+                    run_begin = begin;
+                }
+                run_end = end;
+            }
+            write_words(run_begin, run_end);
+            OCL_CHECK(err, err = q.enqueueMigrateMemObjects({buffer_offsets, buffer_lengths}, 0 /* 0 means from host*/));
+
+            /* KERNEL */
+            OCL_CHECK(err, err = krnl.setArg(4, (uint64_t)n));
+            OCL_CHECK(err, err = q.enqueueTask(krnl));
+
+            /* DEVICE -> HOST */
+            OCL_CHECK(err, err = q.enqueueMigrateMemObjects({buffer_output}, CL_MIGRATE_MEM_OBJECT_HOST));
+            q.finish();
+
+            for (size_t i = 0; i < n; ++i) {
+                out[first + i] = digests[i];
+            }
+        }
+    }
+};
+
+#endif
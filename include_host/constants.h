@@ -1,4 +1,48 @@
 #ifndef CONSTANTS_H
 #define CONSTANTS_H
 
-#endif
\ No newline at end of file
+// Shared memory interface of the hashing daemon (see shm_ring.h)
+#define SHM_NAME "/xxhash_accel"
+#define SHM_LOCK_NAME "/xxhash_accel.lock"     // flock()ed by the running daemon, never removed
+#define SHM_MAGIC 0x786868736d303031ULL
+#define SHM_VERSION 1
+
+#define SHM_MAX_CLIENTS 16                  // replica processes that can attach at the same time
+#define SHM_RING_SLOTS 256                  // request descriptors per client, power of 2
+#define SHM_ARENA_BYTES (1 << 20)           // payload bytes per client, multiple of 4096
+#define SHM_CLIENT_QUANTUM 32               // max requests taken from one client per batch (fairness)
+#define SHM_MAX_BATCH (SHM_MAX_CLIENTS * SHM_CLIENT_QUANTUM)
+
+// Incremental checkpoint digests (see page_cache.h)
+#define HASH_PAGE_BYTES 4096
+#define CHECKPOINT_PAGES 4096               // state size used by the checkpoint test in host.cpp
+
+// Receive ring ingestion (see ring.h), ring size in words has to be a power of 2
+#define RING_WORDS 8192
+#define RING_MAX_RECORDS 2048
+
+// NUMA local vs. remote staging benchmark in host.cpp
+#define NUMA_BENCH_BYTES (64 << 20)
+#define NUMA_BENCH_MSG_BYTES 4096
+
+// Digest index of krnl_dedup (see dedup.h) - keep in sync with include/constants.h
+#define DEDUP_WAYS 4                                    // entries per bucket, clock eviction within a bucket
+#define DEDUP_BUCKETS 4096                              // power of 2
+#define DEDUP_SLOTS (DEDUP_BUCKETS * DEDUP_WAYS)
+#define DEDUP_HAND_BASE (2 * DEDUP_SLOTS)               // index layout: [digest, meta] per slot, then one clock hand per bucket
+#define DEDUP_INDEX_WORDS (DEDUP_HAND_BASE + DEDUP_BUCKETS)
+#define DEDUP_META_VALID 1ULL
+#define DEDUP_META_REF 2ULL
+#define DEDUP_SEEN_FLAG 0x80000000U                     // flags[m]: seen before | slot
+#define DEDUP_OP_LOOKUP 0
+#define DEDUP_OP_CLEAR 1
+#define DEDUP_TEST_MSGS 4096                            // batch size of the dedup test in host.cpp
+
+// krnl_copy - keep in sync with include/constants.h
+#define COPY_MAX_WORDS 512                              // longest message (in words) that can be verified before it is written
+#define COPY_OK 0
+#define COPY_MISMATCH 1                                 // digest != expected, nothing written
+#define COPY_TOO_LONG 2                                 // verify requested but longer than COPY_MAX_WORDS, nothing written
+#define COPY_TEST_MSGS 1024                             // batch size of the copy-and-hash test in host.cpp
+
+#endif
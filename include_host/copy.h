@@ -0,0 +1,114 @@
+#ifndef COPY_H
+#define COPY_H
+
+#include "host.h"
+#include "constants.h"
+#include "backend.h"
+#include "xxhash64.h"
+#include <vector>
+#include <cstdint>
+
+// host reference of krnl_copy - same arguments, same results in dest, digests and status
+void copy_and_hash_sw(const uint64_t* input, const uint64_t* offsets, const uint64_t* lengths, uint64_t* dest,
+                      const uint64_t* dest_offsets, const uint64_t* expected, uint64_t* digests, uint32_t* status,
+                      size_t num_msgs, bool verify) {
+    for (size_t m = 0; m < num_msgs; ++m) {
+        uint64_t words = (lengths[m] + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+        digests[m] = XXHash64::hash(input + offsets[m], lengths[m], 0);
+
+        if (verify && words > COPY_MAX_WORDS) {
+            status[m] = COPY_TOO_LONG;
+        } else if (verify && digests[m] != expected[m]) {
+            status[m] = COPY_MISMATCH;
+        } else {
+            for (uint64_t i = 0; i < words; ++i) {
+                dest[dest_offsets[m] + i] = input[offsets[m] + i];
+            }
+            status[m] = COPY_OK;
+        }
+    }
+}
+
+/* Runs krnl_copy between two registered regions (CL_MEM_USE_HOST_PTR, 4096 byte aligned)
+The messages are written to the device, and the words of every committed copy are read back into dest -
+there is no host memcpy, and no second read of the input for hashing.
+*/
+struct device_copy {
+    cl::CommandQueue q;
+    cl::Kernel krnl;
+    uint64_t* src;
+    uint64_t* dst;
+    size_t max_batch;
+
+    std::vector<uint64_t, aligned_allocator<uint64_t> > offsets, lengths, dest_offsets, expected, digests;
+    std::vector<uint32_t, aligned_allocator<uint32_t> > status;
+    word_ranges source;
+    cl::Buffer buffer_src, buffer_dst, buffer_offsets, buffer_lengths, buffer_dest_offsets, buffer_expected, buffer_output, buffer_status;
+
+    device_copy(cl::Context& context, cl::CommandQueue& q, cl::Program& program, uint64_t* src, size_t src_bytes,
+                uint64_t* dst, size_t dst_bytes, size_t max_batch)
+        : q(q), src(src), dst(dst), max_batch(max_batch), offsets(max_batch), lengths(max_batch), dest_offsets(max_batch),
+          expected(max_batch), digests(max_batch), status(max_batch) {
+        cl_int err;
+        OCL_CHECK(err, krnl = cl::Kernel(program, "krnl_copy", &err));
+        OCL_CHECK(err, buffer_src = cl::Buffer(context, CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY, src_bytes, src, &err));
+        OCL_CHECK(err, buffer_dst = cl::Buffer(context, CL_MEM_USE_HOST_PTR | CL_MEM_WRITE_ONLY, dst_bytes, dst, &err));
+        OCL_CHECK(err, buffer_offsets = cl::Buffer(context, CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY, sizeof(uint64_t) * max_batch, offsets.data(), &err));
+        OCL_CHECK(err, buffer_lengths = cl::Buffer(context, CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY, sizeof(uint64_t) * max_batch, lengths.data(), &err));
+        OCL_CHECK(err, buffer_dest_offsets = cl::Buffer(context, CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY, sizeof(uint64_t) * max_batch, dest_offsets.data(), &err));
+        OCL_CHECK(err, buffer_expected = cl::Buffer(context, CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY, sizeof(uint64_t) * max_batch, expected.data(), &err));
+        OCL_CHECK(err, buffer_output = cl::Buffer(context, CL_MEM_USE_HOST_PTR | CL_MEM_WRITE_ONLY, sizeof(uint64_t) * max_batch, digests.data(), &err));
+        OCL_CHECK(err, buffer_status = cl::Buffer(context, CL_MEM_USE_HOST_PTR | CL_MEM_WRITE_ONLY, sizeof(uint32_t) * max_batch, status.data(), &err));
+
+        OCL_CHECK(err, err = krnl.setArg(0, buffer_src));
+        OCL_CHECK(err, err = krnl.setArg(1, buffer_offsets));
+        OCL_CHECK(err, err = krnl.setArg(2, buffer_lengths));
+        OCL_CHECK(err, err = krnl.setArg(3, buffer_dst));
+        OCL_CHECK(err, err = krnl.setArg(4, buffer_dest_offsets));
+        OCL_CHECK(err, err = krnl.setArg(5, buffer_expected));
+        OCL_CHECK(err, err = krnl.setArg(6, buffer_output));
+        OCL_CHECK(err, err = krnl.setArg(7, buffer_status));
+    }
+
+    /* copies and hashes num_msgs messages in kernel calls of up to max_batch messages, expected may be nullptr when
+    verify is false - out_digests and out_status get one entry per message
+    */
+    void copy_batch(const uint64_t* offs, const uint64_t* lens, const uint64_t* dest_offs, const uint64_t* exp,
+                    size_t num_msgs, bool verify, uint64_t* out_digests, uint32_t* out_status) {
+        cl_int err;
+        for (size_t first = 0; first < num_msgs; first += max_batch) {
+            size_t n = (num_msgs - first < max_batch) ? num_msgs - first : max_batch;
+
+            /* HOST -> DEVICE: source words, each run of them once */
+            for (size_t i = 0; i < n; ++i) {
+                offsets[i] = offs[first + i];
+                lengths[i] = lens[first + i];
+                dest_offsets[i] = dest_offs[first + i];
+                expected[i] = exp ? exp[first + i] : 0;
+                source.add(offsets[i], offsets[i] + (lengths[i] + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+            }
+            source.write(q, buffer_src, src);
+            OCL_CHECK(err, err = q.enqueueMigrateMemObjects({buffer_offsets, buffer_lengths, buffer_dest_offsets, buffer_expected}, 0 /* 0 means from host*/));
+
+            OCL_CHECK(err, err = krnl.setArg(8, (uint64_t)n));
+            OCL_CHECK(err, err = krnl.setArg(9, (uint64_t)verify));
+            OCL_CHECK(err, err = q.enqueueTask(krnl));
+
+            OCL_CHECK(err, err = q.enqueueMigrateMemObjects({buffer_output, buffer_status}, CL_MIGRATE_MEM_OBJECT_HOST));
+            q.finish();
+
+            /* DEVICE -> HOST: committed copies only */
+            for (size_t i = 0; i < n; ++i) {
+                size_t words = (lengths[i] + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+                if (status[i] == COPY_OK && words) {
+                    OCL_CHECK(err, err = q.enqueueReadBuffer(buffer_dst, CL_FALSE, dest_offsets[i] * sizeof(uint64_t), words * sizeof(uint64_t), dst + dest_offsets[i]));
+                }
+                out_digests[first + i] = digests[i];
+                out_status[first + i] = status[i];
+            }
+            q.finish();
+        }
+    }
+};
+
+#endif
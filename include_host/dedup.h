@@ -0,0 +1,182 @@
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#include "host.h"
+#include "constants.h"
+#include "backend.h"
+#include "xxhash64.h"
+#include <vector>
+#include <cstdint>
+
+/* Index of recent digests, as krnl_dedup keeps it in device memory
+
+DEDUP_BUCKETS buckets of DEDUP_WAYS slots, slot s is [digest, meta] at words 2s and 2s+1, the clock hand of
+bucket b at word DEDUP_HAND_BASE + b. dedup_index_sw is the host reference of the kernel and also builds the
+images that seed the device.
+*/
+struct dedup_index_sw {
+    std::vector<uint64_t> index;
+
+    dedup_index_sw() : index(DEDUP_INDEX_WORDS, 0) {}
+
+    void clear() {
+        index.assign(DEDUP_INDEX_WORDS, 0);
+    }
+
+    // same as one message of krnl_dedup, returns the flag
+    uint32_t lookup_insert(uint64_t digest) {
+        uint64_t bucket = digest & (DEDUP_BUCKETS - 1);
+        uint64_t first = bucket * DEDUP_WAYS;
+
+        for (int w = 0; w < DEDUP_WAYS; ++w) {
+            uint64_t slot = first + w;
+            if ((index[2 * slot + 1] & DEDUP_META_VALID) && index[2 * slot] == digest) {
+                index[2 * slot + 1] |= DEDUP_META_REF;
+                return DEDUP_SEEN_FLAG | (uint32_t)slot;
+            }
+        }
+
+        uint64_t hand = index[DEDUP_HAND_BASE + bucket];
+        for (int step = 0; step < 2 * DEDUP_WAYS; ++step) {
+            uint64_t m = index[2 * (first + hand) + 1];
+            if (!(m & DEDUP_META_VALID) || !(m & DEDUP_META_REF)) break;
+            index[2 * (first + hand) + 1] = m & ~DEDUP_META_REF;
+            hand = (hand + 1) % DEDUP_WAYS;
+        }
+        index[2 * (first + hand)] = digest;
+        index[2 * (first + hand) + 1] = DEDUP_META_VALID | DEDUP_META_REF;
+        index[DEDUP_HAND_BASE + bucket] = (hand + 1) % DEDUP_WAYS;
+        return (uint32_t)(first + hand);
+    }
+
+    // digests currently in the index, in slot order
+    std::vector<uint64_t> digests() const {
+        std::vector<uint64_t> out;
+        for (uint64_t slot = 0; slot < DEDUP_SLOTS; ++slot) {
+            if (index[2 * slot + 1] & DEDUP_META_VALID) out.push_back(index[2 * slot]);
+        }
+        return out;
+    }
+};
+
+/* Runs krnl_dedup on messages in a registered region (same layout and rules as device_backend)
+The index never leaves the device during lookups: seed() uploads it (from digests or a raw image), snapshot() reads
+the raw image back, clear() empties it on the device. Per batch the host gets one 4 byte flag per message and digests of new messages only.
+*/
+struct device_dedup {
+    cl::CommandQueue q;
+    cl::Kernel krnl;
+    uint64_t* region;
+    size_t max_batch;
+
+    std::vector<uint64_t, aligned_allocator<uint64_t> > offsets, lengths, digests, index, status;
+    std::vector<uint32_t, aligned_allocator<uint32_t> > flags;
+    word_ranges payload;
+    cl::Buffer buffer_region, buffer_offsets, buffer_lengths, buffer_output, buffer_flags, buffer_index, buffer_status;
+
+    device_dedup(cl::Context& context, cl::CommandQueue& q, cl::Program& program, uint64_t* region, size_t region_bytes, size_t max_batch)
+        : q(q), region(region), max_batch(max_batch), offsets(max_batch), lengths(max_batch), digests(max_batch),
+          index(DEDUP_INDEX_WORDS), status(1), flags(max_batch) {
+        cl_int err;
+        OCL_CHECK(err, krnl = cl::Kernel(program, "krnl_dedup", &err));
+        OCL_CHECK(err, buffer_region = cl::Buffer(context, CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY, region_bytes, region, &err));
+        OCL_CHECK(err, buffer_offsets = cl::Buffer(context, CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY, sizeof(uint64_t) * max_batch, offsets.data(), &err));
+        OCL_CHECK(err, buffer_lengths = cl::Buffer(context, CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY, sizeof(uint64_t) * max_batch, lengths.data(), &err));
+        OCL_CHECK(err, buffer_output = cl::Buffer(context, CL_MEM_USE_HOST_PTR | CL_MEM_WRITE_ONLY, sizeof(uint64_t) * max_batch, digests.data(), &err));
+        OCL_CHECK(err, buffer_flags = cl::Buffer(context, CL_MEM_USE_HOST_PTR | CL_MEM_WRITE_ONLY, sizeof(uint32_t) * max_batch, flags.data(), &err));
+        OCL_CHECK(err, buffer_index = cl::Buffer(context, CL_MEM_USE_HOST_PTR | CL_MEM_READ_WRITE, sizeof(uint64_t) * DEDUP_INDEX_WORDS, index.data(), &err));
+        OCL_CHECK(err, buffer_status = cl::Buffer(context, CL_MEM_USE_HOST_PTR | CL_MEM_WRITE_ONLY, sizeof(uint64_t), status.data(), &err));
+
+        OCL_CHECK(err, err = krnl.setArg(0, buffer_region));
+        OCL_CHECK(err, err = krnl.setArg(1, buffer_offsets));
+        OCL_CHECK(err, err = krnl.setArg(2, buffer_lengths));
+        OCL_CHECK(err, err = krnl.setArg(3, buffer_output));
+        OCL_CHECK(err, err = krnl.setArg(4, buffer_flags));
+        OCL_CHECK(err, err = krnl.setArg(5, buffer_index));
+        OCL_CHECK(err, err = krnl.setArg(6, buffer_status));
+        clear();
+    }
+
+    void clear() {
+        cl_int err;
+        OCL_CHECK(err, err = krnl.setArg(7, (uint64_t)0));
+        OCL_CHECK(err, err = krnl.setArg(8, (uint64_t)DEDUP_OP_CLEAR));
+        OCL_CHECK(err, err = q.enqueueTask(krnl));
+        q.finish();
+    }
+
+    // replaces the index with one holding these digests (inserted in order, like the kernel would)
+    void seed(const std::vector<uint64_t>& seeds) {
+        dedup_index_sw image;
+        for (uint64_t d : seeds) {
+            image.lookup_insert(d);
+        }
+        seed(image.index.data());
+    }
+
+    /* replaces the index with a raw image of DEDUP_INDEX_WORDS words (what snapshot() returns)
+    false, with the device index untouched, if a clock hand is out of range - the kernel would index past its bucket
+    */
+    bool seed(const uint64_t* image) {
+        cl_int err;
+        for (uint64_t b = 0; b < DEDUP_BUCKETS; ++b) {
+            if (image[DEDUP_HAND_BASE + b] >= DEDUP_WAYS) return false;
+        }
+        std::copy(image, image + DEDUP_INDEX_WORDS, index.begin());
+        OCL_CHECK(err, err = q.enqueueMigrateMemObjects({buffer_index}, 0 /* 0 means from host*/));
+        q.finish();
+        return true;
+    }
+
+    // reads the index back - the raw image, DEDUP_INDEX_WORDS words laid out like dedup_index_sw::index
+    std::vector<uint64_t> snapshot() {
+        cl_int err;
+        OCL_CHECK(err, err = q.enqueueMigrateMemObjects({buffer_index}, CL_MIGRATE_MEM_OBJECT_HOST));
+        q.finish();
+        return std::vector<uint64_t>(index.begin(), index.end());
+    }
+
+    /* hashes num_msgs messages and checks them against the index, in kernel calls of up to max_batch messages
+    out_flags gets a flag per message, out_digests the digests of new messages in order - returns how many
+    */
+    size_t hash_batch(const uint64_t* offs, const uint64_t* lens, size_t num_msgs, uint32_t* out_flags, uint64_t* out_digests) {
+        cl_int err;
+        size_t total = 0;
+        for (size_t first = 0; first < num_msgs; first += max_batch) {
+            size_t n = (num_msgs - first < max_batch) ? num_msgs - first : max_batch;
+
+            /* HOST -> DEVICE: payload words, each run of them once even when messages repeat */
+            for (size_t i = 0; i < n; ++i) {
+                offsets[i] = offs[first + i];
+                lengths[i] = lens[first + i];
+                payload.add(offsets[i], offsets[i] + (lengths[i] + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+            }
+            payload.write(q, buffer_region, region);
+            OCL_CHECK(err, err = q.enqueueMigrateMemObjects({buffer_offsets, buffer_lengths}, 0 /* 0 means from host*/));
+
+            OCL_CHECK(err, err = krnl.setArg(7, (uint64_t)n));
+            OCL_CHECK(err, err = krnl.setArg(8, (uint64_t)DEDUP_OP_LOOKUP));
+            OCL_CHECK(err, err = q.enqueueTask(krnl));
+
+            /* DEVICE -> HOST: flags and the count, then the new digests only */
+            OCL_CHECK(err, err = q.enqueueReadBuffer(buffer_flags, CL_FALSE, 0, n * sizeof(uint32_t), flags.data()));
+            OCL_CHECK(err, err = q.enqueueMigrateMemObjects({buffer_status}, CL_MIGRATE_MEM_OBJECT_HOST));
+            q.finish();
+            size_t fresh = status[0];
+            if (fresh) {
+                OCL_CHECK(err, err = q.enqueueReadBuffer(buffer_output, CL_TRUE, 0, fresh * sizeof(uint64_t), digests.data()));
+            }
+
+            for (size_t i = 0; i < n; ++i) {
+                out_flags[first + i] = flags[i];
+            }
+            for (size_t i = 0; i < fresh; ++i) {
+                out_digests[total + i] = digests[i];
+            }
+            total += fresh;
+        }
+        return total;
+    }
+};
+
+#endif
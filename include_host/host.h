@@ -21,21 +21,78 @@
 #include <fstream>
 #include <sstream>
 #include <climits>
+#include <algorithm>
 #include <sys/stat.h>
 #include <string>
 #include <iomanip>
 #include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <numa.h>
+#include <numaif.h>
 
+/* NUMA placement of staging buffers
+staging_numa_node() is the node aligned_allocator puts its pages on, -1 leaves placement to the kernel.
+Everything here is a no-op on machines with a single node or without NUMA support.
+*/
+int& staging_numa_node() {
+    static int node = -1;
+    return node;
+}
+
+bool numa_multi_node() {
+    return numa_available() >= 0 && numa_num_configured_nodes() > 1;
+}
+
+/* binds the pages of a buffer to node - before they are touched, or they are moved there
+ptr and bytes have to cover whole pages, the binding would otherwise also move (and stay on) whatever shares
+the first and last page
+*/
+bool numa_bind_buffer(void* ptr, size_t bytes, int node) {
+    size_t sys_page = sysconf(_SC_PAGESIZE);
+    if (node < 0 || !numa_multi_node() || bytes == 0) return false;
+    if ((uintptr_t)ptr % sys_page || bytes % sys_page) return false;
+    struct bitmask* nodes = numa_allocate_nodemask();
+    numa_bitmask_setbit(nodes, node);
+    bool ok = mbind(ptr, bytes, MPOL_BIND, nodes->maskp, nodes->size + 1, MPOL_MF_MOVE) == 0;
+    numa_free_nodemask(nodes);
+    return ok;
+}
+
+// node the page at ptr is on (after it was touched), -1 if unknown
+int numa_node_of(const void* ptr) {
+    int node = -1;
+    if (numa_available() < 0 || get_mempolicy(&node, nullptr, 0, (void*)ptr, MPOL_F_NODE | MPOL_F_ADDR) != 0) return -1;
+    return node;
+}
+
+// a node other than local this process may allocate on, -1 if there is none
+int numa_remote_node(int local) {
+    if (!numa_multi_node()) return -1;
+    int remote = -1;
+    struct bitmask* allowed = numa_get_mems_allowed();
+    for (int node = 0; node <= numa_max_node() && remote < 0; ++node) {
+        if (node != local && numa_bitmask_isbitset(allowed, node)) remote = node;
+    }
+    numa_bitmask_free(allowed);
+    return remote;
+}
+
+/* with a staging node set (when the container is created), buffers are mapped on their own and bound as a whole,
+so no policy is left on heap pages that malloc hands out again later
+*/
 template <typename T>
 struct aligned_allocator {
     using value_type = T;
+    int node;
 
-    aligned_allocator() {}
+    aligned_allocator() : node(numa_multi_node() ? staging_numa_node() : -1) {}
 
-    aligned_allocator(const aligned_allocator&) {}
+    aligned_allocator(const aligned_allocator& other) : node(other.node) {}
 
     template <typename U>
-    aligned_allocator(const aligned_allocator<U>&) {}
+    aligned_allocator(const aligned_allocator<U>& other) : node(other.node) {}
 
     T* allocate(std::size_t num) {
         void* ptr = nullptr;
@@ -49,7 +106,11 @@ struct aligned_allocator {
             }
         }
 #else
-        {
+        if (node >= 0) {
+            ptr = mmap(nullptr, mapped_bytes(num), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (ptr == MAP_FAILED) throw std::bad_alloc();
+            numa_bind_buffer(ptr, mapped_bytes(num), node);
+        } else {
             if (posix_memalign(&ptr, 4096, num * sizeof(T))) throw std::bad_alloc();
         }
 #endif
@@ -59,11 +120,30 @@ struct aligned_allocator {
 #if defined(_WINDOWS)
         _aligned_free(p);
 #else
-        free(p);
+        if (node >= 0) {
+            munmap(p, mapped_bytes(num));
+        } else {
+            free(p);
+        }
 #endif
     }
+
+    static size_t mapped_bytes(std::size_t num) {
+        size_t sys_page = sysconf(_SC_PAGESIZE);
+        return (std::max(num * sizeof(T), (size_t)1) + sys_page - 1) / sys_page * sys_page;
+    }
 };
 
+template <typename T, typename U>
+bool operator==(const aligned_allocator<T>& a, const aligned_allocator<U>& b) {
+    return a.node == b.node;
+}
+
+template <typename T, typename U>
+bool operator!=(const aligned_allocator<T>& a, const aligned_allocator<U>& b) {
+    return !(a == b);
+}
+
 std::vector<cl::Device> get_devices(const std::string& vendor_name) {
     size_t i;
     cl_int err;
@@ -118,6 +198,39 @@ cl::Device find_device_bdf(const std::vector<cl::Device>& devices, const std::st
     }
     return device;
 }
+/* NUMA node the card hangs off, from its PCIe BDF - -1 if the platform does not tell
+XRT reports the BDF without the PCI domain on some platforms, sysfs always wants it
+*/
+int find_device_numa_node(const cl::Device& device) {
+    char device_bdf[20] = {0};
+    cl_int err = device.getInfo(CL_DEVICE_PCIE_BDF, &device_bdf);
+    if (err != CL_SUCCESS || device_bdf[0] == '\0') return -1;
+
+    std::string bdf = device_bdf;
+    if (std::count(bdf.begin(), bdf.end(), ':') == 1) bdf = "0000:" + bdf;
+    std::ifstream numa_file("/sys/bus/pci/devices/" + bdf + "/numa_node");
+    int node = -1;
+    if (!(numa_file >> node)) return -1;
+    return node;
+}
+
+// pins the calling thread to the cores of node, false (and unpinned) on single node boxes
+bool pin_thread_to_node(int node) {
+    if (node < 0 || !numa_multi_node()) return false;
+    struct bitmask* cpus = numa_allocate_cpumask();
+    bool ok = false;
+    if (numa_node_to_cpus(node, cpus) == 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (unsigned int cpu = 0; cpu < cpus->size && cpu < CPU_SETSIZE; ++cpu) {
+            if (numa_bitmask_isbitset(cpus, cpu)) CPU_SET(cpu, &set);
+        }
+        ok = pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+    }
+    numa_free_cpumask(cpus);
+    return ok;
+}
+
 cl_device_id find_device_bdf_c(cl_device_id* devices, const std::string& bdf, cl_uint device_count) {
     char device_bdf[20];
     cl_int err;
@@ -160,6 +273,30 @@ std::vector<unsigned char> read_binary_file(const std::string& xclbin_file_name)
     return buf;
 }
 
+// Programs the first Xilinx device that accepts the xclbin, exits if there is none
+cl::Program program_xil_device(const std::string& binaryFile, cl::Context& context, cl::CommandQueue& q, cl::Device* chosen = nullptr) {
+    cl_int err;
+    auto devices = get_xil_devices();
+    auto fileBuf = read_binary_file(binaryFile);
+    cl::Program::Binaries bins{{fileBuf.data(), fileBuf.size()}};
+    for (unsigned int i = 0; i < devices.size(); i++) {
+        auto device = devices[i];
+        OCL_CHECK(err, context = cl::Context(device, nullptr, nullptr, nullptr, &err));
+        OCL_CHECK(err, q = cl::CommandQueue(context, device, 0, &err));
+        std::cout << "Trying to program device[" << i << "]: " << device.getInfo<CL_DEVICE_NAME>() << std::endl;
+        cl::Program program(context, {device}, bins, nullptr, &err);
+        if (err != CL_SUCCESS) {
+            std::cout << "Failed to program device[" << i << "] with xclbin file!\n";
+        } else {
+            std::cout << "Device[" << i << "]: program successful!\n";
+            if (chosen) *chosen = device;
+            return program;
+        }
+    }
+    std::cout << "Failed to program any device found, exit!\n";
+    exit(EXIT_FAILURE);
+}
+
 bool is_emulation() {
     bool ret = false;
     char* xcl_mode = getenv("XCL_EMULATION_MODE");
@@ -0,0 +1,173 @@
+#ifndef PAGE_CACHE_H
+#define PAGE_CACHE_H
+
+#include "constants.h"
+#include "backend.h"
+#include "xxhash64.h"
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* Incremental digest of a large mutable state (BFT checkpoints)
+
+The state is split into HASH_PAGE_BYTES pages. Every page keeps its XXHash64 digest, and the page digests are
+combined pairwise into a hash tree whose root is the checkpoint digest. Pages written since the last checkpoint
+are found either through explicit mark_dirty() calls or through a soft-dirty scan of /proc/self/pagemap.
+checkpoint() sends only the dirty pages to the backend as one batch and recomputes only their paths to the root,
+so its cost follows the bytes changed, not the size of the state.
+
+The backend has to be created on the state itself (its region is the state, word offsets are relative to it).
+*/
+
+class page_hash_cache {
+  public:
+    page_hash_cache(uint64_t* state, size_t state_bytes, hash_backend& backend)
+        : state(state), state_bytes(state_bytes), backend(backend), hashed(0), probe(0) {
+        num_pages = (state_bytes + HASH_PAGE_BYTES - 1) / HASH_PAGE_BYTES;
+        for (size_t n = std::max(num_pages, (size_t)1); ; n = (n + 1) / 2) {
+            levels.push_back(std::vector<uint64_t>(n));
+            if (n == 1) break;
+        }
+        dirty.assign(num_pages, 0);
+        mark_dirty(0, state_bytes);
+    }
+
+    size_t pages() const { return num_pages; }
+
+    // pages hashed by the last checkpoint()
+    size_t pages_hashed() const { return hashed; }
+
+    void mark_dirty(size_t offset, size_t length) {
+        if (length == 0 || offset >= state_bytes) return;
+        size_t last = std::min(offset + length, state_bytes) - 1;
+        for (size_t p = offset / HASH_PAGE_BYTES; p <= last / HASH_PAGE_BYTES; ++p) {
+            if (!dirty[p]) {
+                dirty[p] = 1;
+                dirty_pages.push_back(p);
+            }
+        }
+    }
+
+    /* Starts soft-dirty tracking: clears the soft-dirty bits of every page of the process (not only the state!)
+    returns false if the kernel does not track soft-dirty pages - fall back to mark_dirty() then
+
+    The bits are per process, so only one soft-dirty user per process is supported: another page_hash_cache (or
+    anything else writing clear_refs) would clear the bits this one has not scanned yet.
+    */
+    bool clear_soft_dirty() {
+        if (!clear_refs()) return false;
+
+        // kernels without CONFIG_MEM_SOFT_DIRTY accept the write but never set the bit - check with a write of our own
+        *(volatile uint64_t*)&probe = probe + 1;
+        int fd = open("/proc/self/pagemap", O_RDONLY);
+        if (fd < 0) return false;
+        uint64_t entry = 0;
+        size_t sys_page = sysconf(_SC_PAGESIZE);
+        bool ok = pread(fd, &entry, sizeof(entry), (uintptr_t)&probe / sys_page * sizeof(uint64_t)) == sizeof(entry);
+        close(fd);
+        return ok && (entry & SOFT_DIRTY_BIT);
+    }
+
+    /* marks every page of the state the kernel saw written since the last clear_soft_dirty(), then clears again
+    The bits are cleared right after pagemap is read, before anything else - a write that lands between the two
+    system calls is still lost, so writers of the state have to be paused while this runs.
+    */
+    bool scan_soft_dirty() {
+        int fd = open("/proc/self/pagemap", O_RDONLY);
+        if (fd < 0) return false;
+
+        size_t sys_page = sysconf(_SC_PAGESIZE);
+        uintptr_t begin = (uintptr_t)state / sys_page;
+        uintptr_t end = ((uintptr_t)state + state_bytes + sys_page - 1) / sys_page;
+        entries.resize(end - begin);
+        ssize_t want = entries.size() * sizeof(uint64_t);
+        bool ok = pread(fd, entries.data(), want, begin * sizeof(uint64_t)) == want && clear_refs();
+        close(fd);
+        if (!ok) return false;
+
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (!(entries[i] & SOFT_DIRTY_BIT)) continue;
+            uintptr_t addr = (begin + i) * sys_page;
+            size_t offset = (addr > (uintptr_t)state) ? addr - (uintptr_t)state : 0;
+            mark_dirty(offset, addr + sys_page - (uintptr_t)state - offset);
+        }
+        return true;
+    }
+
+    // rehashes the dirty pages and their paths to the root, returns the root digest
+    uint64_t checkpoint() {
+        std::sort(dirty_pages.begin(), dirty_pages.end());
+        hashed = dirty_pages.size();
+
+        if (!dirty_pages.empty()) {
+            /* leaves - one batch for all dirty pages */
+            offsets.resize(hashed);
+            lengths.resize(hashed);
+            digests.resize(hashed);
+            for (size_t i = 0; i < hashed; ++i) {
+                size_t begin = dirty_pages[i] * HASH_PAGE_BYTES;
+                offsets[i] = begin / sizeof(uint64_t);
+                lengths[i] = std::min((size_t)HASH_PAGE_BYTES, state_bytes - begin);
+            }
+            backend.hash_batch(offsets.data(), lengths.data(), digests.data(), hashed);
+            for (size_t i = 0; i < hashed; ++i) {
+                levels[0][dirty_pages[i]] = digests[i];
+                dirty[dirty_pages[i]] = 0;
+            }
+
+            /* inner nodes - only the parents of nodes that changed, level by level */
+            std::vector<size_t> changed(dirty_pages), parents;
+            for (size_t l = 1; l < levels.size(); ++l) {
+                parents.clear();
+                for (size_t i : changed) {
+                    if (parents.empty() || parents.back() != i / 2) parents.push_back(i / 2);
+                }
+                for (size_t p : parents) {
+                    levels[l][p] = combine(levels[l - 1], p);
+                }
+                changed.swap(parents);
+            }
+            dirty_pages.clear();
+        }
+        return levels.back()[0];
+    }
+
+  private:
+    uint64_t* state;
+    size_t state_bytes;
+    size_t num_pages;
+    hash_backend& backend;
+    size_t hashed;
+    uint64_t probe;
+
+    static const uint64_t SOFT_DIRTY_BIT = 1ULL << 55;     // pagemap entry: pte is soft-dirty
+
+    std::vector<std::vector<uint64_t> > levels;     // levels[0] are the page digests, levels.back()[0] is the root
+    std::vector<uint8_t> dirty;
+    std::vector<size_t> dirty_pages;
+    std::vector<uint64_t> offsets, lengths, digests;
+    std::vector<uint64_t> entries;                  // pagemap entries of the state, kept so a scan does not allocate
+
+    static bool clear_refs() {
+        int fd = open("/proc/self/clear_refs", O_WRONLY);
+        if (fd < 0) return false;
+        bool ok = write(fd, "4", 1) == 1;
+        close(fd);
+        return ok;
+    }
+
+    // parent p covers children 2p and 2p+1 of the level below, a missing right child is left out
+    static uint64_t combine(const std::vector<uint64_t>& below, size_t p) {
+        uint64_t children[2] = {below[2 * p], 0};
+        size_t count = 1;
+        if (2 * p + 1 < below.size()) {
+            children[1] = below[2 * p + 1];
+            count = 2;
+        }
+        return XXHash64::hash(children, count * sizeof(uint64_t), 0);
+    }
+};
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef RING_H
+#define RING_H
+
+#include "host.h"
+#include "xxhash64.h"
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+/* Receive ring of length-prefixed records, as krnl_ring reads it
+
+a record is [length in bytes | payload | padding to the next word], head and tail are free running word
+positions and ring_words is a power of 2 - the word at position p lives at ring[p & (ring_words - 1)]
+*/
+
+uint64_t ring_record_words(uint64_t length) {
+    return 1 + (length + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+}
+
+// producer side (what the NIC / transport does), false if the record does not fit between tail and head
+bool ring_push(uint64_t* ring, uint64_t ring_words, uint64_t head, uint64_t& tail, const void* payload, uint64_t length) {
+    uint64_t words = ring_record_words(length);
+    if (tail - head + words > ring_words) return false;
+
+    uint64_t mask = ring_words - 1;
+    ring[tail & mask] = length;
+    const uint8_t* data = (const uint8_t*)payload;
+    for (uint64_t i = 0; i + 1 < words; ++i) {
+        uint64_t word = 0;
+        uint64_t chunk = (length - i * sizeof(uint64_t) < sizeof(uint64_t)) ? length - i * sizeof(uint64_t) : sizeof(uint64_t);
+        memcpy(&word, data + i * sizeof(uint64_t), chunk);
+        ring[(tail + 1 + i) & mask] = word;
+    }
+    tail += words;
+    return true;
+}
+
+// host reference of krnl_ring, returns the number of records hashed and sets next to the position reached
+uint64_t ring_hash_records_sw(const uint64_t* ring, uint64_t ring_words, uint64_t head, uint64_t tail,
+                              uint64_t* digests, uint64_t max_records, uint64_t* next) {
+    uint64_t mask = ring_words - 1;
+    uint64_t pos = head;
+    uint64_t n = 0;
+    std::vector<uint64_t> payload;
+    while (pos != tail && n < max_records) {
+        uint64_t length = ring[pos & mask];
+        if (length > (tail - pos - 1) * sizeof(uint64_t)) break;     // in bytes, ring_record_words() wraps for huge lengths
+        uint64_t words = ring_record_words(length);
+
+        payload.resize(words - 1);
+        for (uint64_t i = 0; i + 1 < words; ++i) {
+            payload[i] = ring[(pos + 1 + i) & mask];
+        }
+        digests[n++] = XXHash64::hash(payload.data(), length, 0);
+        pos += words;
+    }
+    *next = pos;
+    return n;
+}
+
+/* Runs krnl_ring on a ring that is registered with the device once (CL_MEM_USE_HOST_PTR, 4096 byte aligned)
+Only the words between head and tail are written to the device - in two pieces when they wrap.
+*/
+struct device_ring {
+    cl::CommandQueue q;
+    cl::Kernel krnl;
+    uint64_t* ring;
+    uint64_t ring_words;
+    uint64_t max_records;
+
+    std::vector<uint64_t, aligned_allocator<uint64_t> > digests, status;
+    cl::Buffer buffer_ring, buffer_output, buffer_status;
+
+    device_ring(cl::Context& context, cl::CommandQueue& q, cl::Program& program, uint64_t* ring, uint64_t ring_words, uint64_t max_records)
+        : q(q), ring(ring), ring_words(ring_words), max_records(max_records), digests(max_records), status(2) {
+        cl_int err;
+        OCL_CHECK(err, krnl = cl::Kernel(program, "krnl_ring", &err));
+        OCL_CHECK(err, buffer_ring = cl::Buffer(context, CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY, sizeof(uint64_t) * ring_words, ring, &err));
+        OCL_CHECK(err, buffer_output = cl::Buffer(context, CL_MEM_USE_HOST_PTR | CL_MEM_WRITE_ONLY, sizeof(uint64_t) * max_records, digests.data(), &err));
+        OCL_CHECK(err, buffer_status = cl::Buffer(context, CL_MEM_USE_HOST_PTR | CL_MEM_WRITE_ONLY, sizeof(uint64_t) * 2, status.data(), &err));
+
+        OCL_CHECK(err, err = krnl.setArg(0, buffer_ring));
+        OCL_CHECK(err, err = krnl.setArg(1, buffer_output));
+        OCL_CHECK(err, err = krnl.setArg(2, buffer_status));
+        OCL_CHECK(err, err = krnl.setArg(3, ring_words - 1));
+        OCL_CHECK(err, err = krnl.setArg(6, max_records));
+    }
+
+    // hashes the records in [head, tail) into out, returns how many, next gets the position reached
+    uint64_t hash_records(uint64_t head, uint64_t tail, uint64_t* out, uint64_t* next) {
+        cl_int err;
+        uint64_t mask = ring_words - 1;
+        uint64_t begin = head & mask;
+        uint64_t total = tail - head;
+        uint64_t first = (total < ring_words - begin) ? total : ring_words - begin;
+
+        /* HOST -> DEVICE: the filled part of the ring only */
+        if (first) {
+            OCL_CHECK(err, err = q.enqueueWriteBuffer(buffer_ring, CL_FALSE, begin * sizeof(uint64_t), first * sizeof(uint64_t), ring + begin));
+        }
+        if (total > first) {
+            OCL_CHECK(err, err = q.enqueueWriteBuffer(buffer_ring, CL_FALSE, 0, (total - first) * sizeof(uint64_t), ring));
+        }
+
+        /* KERNEL */
+        OCL_CHECK(err, err = krnl.setArg(4, head));
+        OCL_CHECK(err, err = krnl.setArg(5, tail));
+        OCL_CHECK(err, err = q.enqueueTask(krnl));
+
+        /* DEVICE -> HOST: status first, then only as many digests as there are records */
+        OCL_CHECK(err, err = q.enqueueMigrateMemObjects({buffer_status}, CL_MIGRATE_MEM_OBJECT_HOST));
+        q.finish();
+        uint64_t n = status[0];
+        if (n) {
+            OCL_CHECK(err, err = q.enqueueReadBuffer(buffer_output, CL_TRUE, 0, n * sizeof(uint64_t), digests.data()));
+        }
+        for (uint64_t i = 0; i < n; ++i) {
+            out[i] = digests[i];
+        }
+        *next = status[1];
+        return n;
+    }
+};
+
+#endif
@@ -0,0 +1,236 @@
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include "constants.h"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Shared memory region exported by the hashing daemon
+
+[ shm_header (one slot per client) | pad to 4096 | payload arena: SHM_MAX_CLIENTS slices of SHM_ARENA_BYTES ]
+
+Every client owns one slot - a single producer / single consumer ring of request descriptors - and one
+slice of the arena. Clients write payloads straight into their slice and publish descriptors by bumping head.
+The daemon takes descriptors (tail), hashes the payloads in place - the arena is the region it registered with
+the device - writes the digests into the descriptors and publishes them by bumping completed.
+Requests of one client complete in order.
+*/
+
+struct shm_request {
+    uint64_t offset;        // byte offset of the payload from the start of the arena, 8 byte aligned
+    uint64_t length;        // payload length in bytes
+    uint64_t digest;        // written by the daemon
+};
+
+struct shm_client_stats {
+    uint64_t submitted;
+    uint64_t completed;
+    uint64_t bytes;
+    uint64_t batches;       // daemon batches this client had requests in
+};
+
+struct alignas(64) shm_client_slot {
+    std::atomic<uint32_t> in_use;                   // 0 free, 1 attached, 2 closing - the daemon frees it
+    int32_t pid;
+    alignas(64) std::atomic<uint64_t> head;         // written by the client
+    alignas(64) std::atomic<uint64_t> tail;         // written by the daemon
+    std::atomic<uint64_t> completed;                // written by the daemon
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> batches;
+    shm_request ring[SHM_RING_SLOTS];
+};
+
+struct shm_header {
+    uint64_t magic;
+    uint32_t version;
+    std::atomic<uint32_t> ready;
+    shm_client_slot clients[SHM_MAX_CLIENTS];
+};
+
+size_t shm_arena_offset() {
+    return (sizeof(shm_header) + 4095) & ~(size_t)4095;
+}
+
+size_t shm_region_size() {
+    return shm_arena_offset() + (size_t)SHM_MAX_CLIENTS * SHM_ARENA_BYTES;
+}
+
+// puts a slot back into its initial state - only the daemon does this (for clients that closed or died), it is the
+// only writer of tail and completed
+void shm_reset_slot(shm_client_slot& slot) {
+    slot.head.store(0, std::memory_order_relaxed);
+    slot.tail.store(0, std::memory_order_relaxed);
+    slot.completed.store(0, std::memory_order_relaxed);
+    slot.bytes.store(0, std::memory_order_relaxed);
+    slot.batches.store(0, std::memory_order_relaxed);
+    slot.pid = 0;
+    slot.in_use.store(0, std::memory_order_release);
+}
+
+/* Client side of the daemon
+
+    accel_client c;
+    c.connect();
+    void* p = c.alloc(len);             // space in the shared arena
+    ... write the payload to p ...
+    uint64_t ticket = c.submit(len);
+    uint64_t digest = c.wait(ticket);
+
+A ticket can be polled until SHM_RING_SLOTS newer requests were submitted, after that its descriptor is reused.
+*/
+class accel_client {
+  public:
+    accel_client() : hdr(nullptr), slot(nullptr), arena(nullptr), slot_id(-1), arena_head(0), pending_begin(0), pending_end(0) {}
+    ~accel_client() { disconnect(); }
+
+    bool connect(const std::string& name = SHM_NAME) {
+        int fd = shm_open(name.c_str(), O_RDWR, 0);
+        if (fd < 0) return false;
+        void* ptr = mmap(nullptr, shm_region_size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (ptr == MAP_FAILED) return false;
+
+        hdr = (shm_header*)ptr;
+        if (hdr->magic != SHM_MAGIC || hdr->version != SHM_VERSION || !hdr->ready.load(std::memory_order_acquire)) {
+            unmap();
+            return false;
+        }
+        for (int i = 0; i < SHM_MAX_CLIENTS; ++i) {
+            uint32_t expected = 0;
+            if (hdr->clients[i].in_use.compare_exchange_strong(expected, 1, std::memory_order_acq_rel)) {
+                slot_id = i;
+                break;
+            }
+        }
+        if (slot_id < 0) {
+            unmap();
+            return false;
+        }
+        slot = &hdr->clients[slot_id];
+        slot->pid = getpid();
+        arena = (uint8_t*)ptr + shm_arena_offset() + (size_t)slot_id * SHM_ARENA_BYTES;
+        arena_head = 0;
+        return true;
+    }
+
+    // waits for outstanding requests, then hands the slot back to the daemon, which resets and frees it
+    void disconnect() {
+        if (!slot) return;
+        uint64_t head = slot->head.load(std::memory_order_relaxed);
+        while (slot->completed.load(std::memory_order_acquire) != head) sched_yield();
+        slot->in_use.store(2, std::memory_order_release);
+        unmap();
+    }
+
+    /* reserves length bytes of this client's arena slice, nullptr if the slice is full right now
+    lengths above SHM_ARENA_BYTES never fit - those always get nullptr
+    */
+    void* alloc(uint64_t length) {
+        uint64_t need = (length + 7) & ~7ULL;
+        if (need > SHM_ARENA_BYTES) return nullptr;
+
+        // nothing in flight - start at the next slice boundary, so a payload of up to the whole slice fits; the skipped
+        // tail is released with the last completed request, or released() would count it until the next one completes
+        uint64_t done = slot->completed.load(std::memory_order_acquire);
+        if (done == slot->head.load(std::memory_order_relaxed) && arena_head % SHM_ARENA_BYTES) {
+            arena_head += SHM_ARENA_BYTES - arena_head % SHM_ARENA_BYTES;
+            if (done) arena_end[(done - 1) % SHM_RING_SLOTS] = arena_head;
+        }
+
+        uint64_t begin = arena_head;
+        uint64_t pos = begin % SHM_ARENA_BYTES;
+        if (pos + need > SHM_ARENA_BYTES) begin += SHM_ARENA_BYTES - pos;     // payloads never wrap
+        uint64_t end = begin + need;
+        if (end - released() > SHM_ARENA_BYTES) return nullptr;
+
+        pending_begin = begin;
+        pending_end = end;
+        return arena + begin % SHM_ARENA_BYTES;
+    }
+
+    /* publishes the payload of the last alloc(), returns the ticket to poll/wait on
+    at most SHM_RING_SLOTS - 1 requests are in flight: the arena_end entry of the last completed request, which
+    released() reads, must not be reused by a request that still holds its payload
+    */
+    uint64_t submit(uint64_t length) {
+        uint64_t seq = slot->head.load(std::memory_order_relaxed);
+        while (seq - slot->completed.load(std::memory_order_acquire) >= SHM_RING_SLOTS - 1) sched_yield();
+
+        shm_request& req = slot->ring[seq % SHM_RING_SLOTS];
+        req.offset = (uint64_t)slot_id * SHM_ARENA_BYTES + pending_begin % SHM_ARENA_BYTES;
+        req.length = length;
+        arena_end[seq % SHM_RING_SLOTS] = pending_end;
+        arena_head = pending_end;
+
+        slot->head.store(seq + 1, std::memory_order_release);
+        return seq;
+    }
+
+    bool poll(uint64_t ticket, uint64_t* digest) const {
+        if (slot->completed.load(std::memory_order_acquire) <= ticket) return false;
+        *digest = slot->ring[ticket % SHM_RING_SLOTS].digest;
+        return true;
+    }
+
+    uint64_t wait(uint64_t ticket) const {
+        uint64_t digest;
+        for (uint64_t spins = 0; !poll(ticket, &digest); ++spins) {
+            if (spins > 1000) sched_yield();
+        }
+        return digest;
+    }
+
+    // copies the payload into the arena and waits for the digest, false if it can never fit the slice
+    bool hash(const void* input, uint64_t length, uint64_t* digest) {
+        if (length > SHM_ARENA_BYTES) return false;
+        void* dst;
+        while ((dst = alloc(length)) == nullptr) sched_yield();
+        memcpy(dst, input, length);
+        *digest = wait(submit(length));
+        return true;
+    }
+
+    shm_client_stats stats() const {
+        shm_client_stats s;
+        s.submitted = slot->head.load(std::memory_order_relaxed);
+        s.completed = slot->completed.load(std::memory_order_acquire);
+        s.bytes = slot->bytes.load(std::memory_order_relaxed);
+        s.batches = slot->batches.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    int id() const { return slot_id; }
+
+  private:
+    shm_header* hdr;
+    shm_client_slot* slot;
+    uint8_t* arena;
+    int slot_id;
+    uint64_t arena_head;                    // arena positions grow monotonically, slice offset = position % SHM_ARENA_BYTES
+    uint64_t pending_begin, pending_end;
+    uint64_t arena_end[SHM_RING_SLOTS];     // arena position freed once that request completes
+
+    // everything before this arena position belongs to completed requests
+    uint64_t released() const {
+        uint64_t done = slot->completed.load(std::memory_order_acquire);
+        if (done == slot->head.load(std::memory_order_relaxed)) return arena_head;
+        return (done == 0) ? 0 : arena_end[(done - 1) % SHM_RING_SLOTS];
+    }
+
+    void unmap() {
+        munmap(hdr, shm_region_size());
+        hdr = nullptr;
+        slot = nullptr;
+        arena = nullptr;
+        slot_id = -1;
+    }
+};
+
+#endif
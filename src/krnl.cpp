@@ -56,11 +56,12 @@ XXHash64 XXHash64::create(uint64_t seed) {
 
 /* add function takes in uint64_t - as used by ubft (this was a void pointer but it is not supported in HLS) 
 Also - it returns updated hasher object and does not deal with pointer of hasher
+length is in bytes (at most 8) - only the low length bytes of input are hashed
 */ 
 
 XXHash64 XXHash64::add(XXHash64 xxh, uint64_t input, uint64_t length) {
-    // Check for no data
-    if (!input || length == 0) return xxh;
+    // Check for no data - a zero word is still data, only length says there is nothing to add
+    if (length == 0) return xxh;
 
     xxh.totalLength += length;
     
@@ -76,7 +77,8 @@ XXHash64 XXHash64::add(XXHash64 xxh, uint64_t input, uint64_t length) {
     uint64_t spaceLeft = MaxBufferSize - xxh.bufferSize;
 
     // If all data fits into the remaining buffer space
-    if (length <= spaceLeft) {
+    // (strictly less: a buffer that becomes full has to be processed right away)
+    if (length < spaceLeft) {
         for (uint64_t i = 0; i < length; ++i) {
             xxh.buffer[xxh.bufferSize + i] = data[i];
         }
@@ -241,26 +243,225 @@ extern "C" {
         printf("Total length: %llu\n", xxh.totalLength);
     }
 
-    void krnl(uint64_t* input, uint64_t* output) {                     
+    /* Batched kernel: hashes num_msgs messages in one invocation
+    message m is lengths[m] bytes long and starts at word offsets[m] of input
+    every message gets its own digest in output[m] - the hasher is re-initialized by hash()
+    the host (and the daemon) place payloads at word boundaries, so messages never share a word
+    */
+    void krnl(uint64_t* input, uint64_t* offsets, uint64_t* lengths, uint64_t* output, uint64_t num_msgs) {
         #pragma HLS INTERFACE m_axi port = input bundle = gmem0
+        #pragma HLS INTERFACE m_axi port = offsets bundle = gmem2
+        #pragma HLS INTERFACE m_axi port = lengths bundle = gmem2
         #pragma HLS INTERFACE m_axi port = output bundle = gmem1
 
-       
         uint64_t seed = 0;  
         XXHash64 hasher = XXHash64::create(seed);
 
-        for (size_t i = 0; i < 3; ++i) {
-            printf("Ele and size: %llu %zu\n", input[i], sizeof(input[i]));
-            hasher = hasher.add(hasher, input[i], sizeof(input[i]));
-            // printXXHash64(hasher);
-        }
+        for (uint64_t m = 0; m < num_msgs; ++m) {
+            uint64_t base = offsets[m];
+            uint64_t length = lengths[m];
+
+            for (uint64_t i = 0; i < length; i += sizeof(uint64_t)) {
+                uint64_t chunk = (length - i < sizeof(uint64_t)) ? length - i : sizeof(uint64_t);
+                hasher = hasher.add(hasher, input[base + i / sizeof(uint64_t)], chunk);
+                // printXXHash64(hasher);
+            }
 
-        HashResult hashResult = hasher.hash(hasher);
-        hasher = hashResult.xxh;
-        output[0] = hashResult.hash;
+            HashResult hashResult = hasher.hash(hasher);
+            hasher = hashResult.xxh;
+            output[m] = hashResult.hash;
+        }
 
         // Print the hash result
         // printf("Hash from krnl: %llu\n", output[0]);
 
     }
+
+    /* Ring ingestion kernel: hashes the records of a receive ring in place, no repacking on the host
+    a record is [length in bytes | payload | padding to the next word]
+    head and tail are free running word positions, ring_mask + 1 (a power of 2) is the ring size in words -
+    positions wrap around on the device, so a record may straddle the end of the ring
+    records from head up to tail are hashed in order into output
+    status[0] = records hashed, status[1] = position reached (== tail unless max_records or a bad record stopped it)
+    */
+    void krnl_ring(uint64_t* ring, uint64_t* output, uint64_t* status, uint64_t ring_mask, uint64_t head, uint64_t tail, uint64_t max_records) {
+        #pragma HLS INTERFACE m_axi port = ring bundle = gmem0
+        #pragma HLS INTERFACE m_axi port = output bundle = gmem1
+        #pragma HLS INTERFACE m_axi port = status bundle = gmem1
+
+        uint64_t seed = 0;
+        XXHash64 hasher = XXHash64::create(seed);
+        uint64_t pos = head;
+        uint64_t n = 0;
+
+        while (pos != tail && n < max_records) {
+            uint64_t length = ring[pos & ring_mask];
+            // a record that claims to run past tail is not complete (or not a record) - leave it to the host
+            // checked in bytes, rounding a huge length up to words would wrap
+            if (length > (tail - pos - 1) * sizeof(uint64_t)) break;
+            uint64_t words = (length + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+            for (uint64_t i = 0; i < length; i += sizeof(uint64_t)) {
+                uint64_t chunk = (length - i < sizeof(uint64_t)) ? length - i : sizeof(uint64_t);
+                hasher = hasher.add(hasher, ring[(pos + 1 + i / sizeof(uint64_t)) & ring_mask], chunk);
+            }
+
+            HashResult hashResult = hasher.hash(hasher);
+            hasher = hashResult.xxh;
+            output[n++] = hashResult.hash;
+            pos += 1 + words;
+        }
+
+        status[0] = n;
+        status[1] = pos;
+    }
+
+    /* Dedup kernel: hashes a batch like krnl and checks every digest against an index of recent digests
+    the index stays in device memory between invocations (layout in constants.h) - DEDUP_WAYS entries per bucket,
+    a full bucket evicts with the clock policy: referenced entries get a second chance, the hand stops at the first
+    entry that is not referenced
+    flags[m] = DEDUP_SEEN_FLAG | slot for a digest that was in the index, the slot it was inserted at otherwise
+    only digests of new messages are written, densely, to output - status[0] = how many
+    op == DEDUP_OP_CLEAR empties the index instead, without any host transfer
+    */
+    void krnl_dedup(uint64_t* input, uint64_t* offsets, uint64_t* lengths, uint64_t* output, uint32_t* flags,
+                    uint64_t* index, uint64_t* status, uint64_t num_msgs, uint64_t op) {
+        #pragma HLS INTERFACE m_axi port = input bundle = gmem0
+        #pragma HLS INTERFACE m_axi port = offsets bundle = gmem2
+        #pragma HLS INTERFACE m_axi port = lengths bundle = gmem2
+        #pragma HLS INTERFACE m_axi port = output bundle = gmem1
+        #pragma HLS INTERFACE m_axi port = flags bundle = gmem1
+        #pragma HLS INTERFACE m_axi port = status bundle = gmem1
+        #pragma HLS INTERFACE m_axi port = index bundle = gmem3
+
+        if (op == DEDUP_OP_CLEAR) {
+            for (uint64_t i = 0; i < DEDUP_INDEX_WORDS; ++i) {
+                index[i] = 0;
+            }
+            status[0] = 0;
+            return;
+        }
+
+        uint64_t seed = 0;
+        XXHash64 hasher = XXHash64::create(seed);
+        uint64_t fresh = 0;
+
+        for (uint64_t m = 0; m < num_msgs; ++m) {
+            uint64_t base = offsets[m];
+            uint64_t length = lengths[m];
+
+            for (uint64_t i = 0; i < length; i += sizeof(uint64_t)) {
+                uint64_t chunk = (length - i < sizeof(uint64_t)) ? length - i : sizeof(uint64_t);
+                hasher = hasher.add(hasher, input[base + i / sizeof(uint64_t)], chunk);
+            }
+
+            HashResult hashResult = hasher.hash(hasher);
+            hasher = hashResult.xxh;
+            uint64_t digest = hashResult.hash;
+
+            // the whole bucket is read once, looked up in parallel and written back once
+            uint64_t bucket = digest & (DEDUP_BUCKETS - 1);
+            uint64_t first = bucket * DEDUP_WAYS;
+            uint64_t tags[DEDUP_WAYS], meta[DEDUP_WAYS];
+            #pragma HLS ARRAY_PARTITION variable = tags complete
+            #pragma HLS ARRAY_PARTITION variable = meta complete
+            for (int w = 0; w < DEDUP_WAYS; ++w) {
+                tags[w] = index[2 * (first + w)];
+                meta[w] = index[2 * (first + w) + 1];
+            }
+
+            int hit = -1;
+            for (int w = 0; w < DEDUP_WAYS; ++w) {
+                #pragma HLS UNROLL
+                if ((meta[w] & DEDUP_META_VALID) && tags[w] == digest) hit = w;
+            }
+
+            if (hit >= 0) {
+                index[2 * (first + hit) + 1] = meta[hit] | DEDUP_META_REF;
+                flags[m] = DEDUP_SEEN_FLAG | (uint32_t)(first + hit);
+                continue;
+            }
+
+            // clock: at most one turn clears every reference bit, so 2 * DEDUP_WAYS steps always find a victim
+            uint64_t hand = index[DEDUP_HAND_BASE + bucket];
+            for (int step = 0; step < 2 * DEDUP_WAYS; ++step) {
+                if (!(meta[hand] & DEDUP_META_VALID) || !(meta[hand] & DEDUP_META_REF)) break;
+                meta[hand] &= ~DEDUP_META_REF;
+                hand = (hand + 1) % DEDUP_WAYS;
+            }
+            tags[hand] = digest;
+            meta[hand] = DEDUP_META_VALID | DEDUP_META_REF;
+            for (int w = 0; w < DEDUP_WAYS; ++w) {
+                index[2 * (first + w)] = tags[w];
+                index[2 * (first + w) + 1] = meta[w];
+            }
+            index[DEDUP_HAND_BASE + bucket] = (hand + 1) % DEDUP_WAYS;
+
+            flags[m] = (uint32_t)(first + hand);
+            output[fresh++] = digest;
+        }
+
+        status[0] = fresh;
+    }
+
+    /* Copy-and-hash kernel: moves every message to dest while hashing it - one read and one write per word
+    message m is lengths[m] bytes at word offsets[m] of input and goes to word dest_offsets[m] of dest
+    (the last word is copied whole, so dest gets the input's padding bytes too), its digest goes to output[m]
+    verify == 0: words are written as they stream by, status[m] = COPY_OK
+    verify != 0: the message is staged on chip and only written if its digest equals expected[m] -
+    status[m] = COPY_MISMATCH or COPY_TOO_LONG (more than COPY_MAX_WORDS) otherwise, and dest is left alone
+    */
+    void krnl_copy(uint64_t* input, uint64_t* offsets, uint64_t* lengths, uint64_t* dest, uint64_t* dest_offsets,
+                   uint64_t* expected, uint64_t* output, uint32_t* status, uint64_t num_msgs, uint64_t verify) {
+        #pragma HLS INTERFACE m_axi port = input bundle = gmem0
+        #pragma HLS INTERFACE m_axi port = offsets bundle = gmem2
+        #pragma HLS INTERFACE m_axi port = lengths bundle = gmem2
+        #pragma HLS INTERFACE m_axi port = dest_offsets bundle = gmem2
+        #pragma HLS INTERFACE m_axi port = expected bundle = gmem2
+        #pragma HLS INTERFACE m_axi port = dest bundle = gmem3
+        #pragma HLS INTERFACE m_axi port = output bundle = gmem1
+        #pragma HLS INTERFACE m_axi port = status bundle = gmem1
+
+        uint64_t staging[COPY_MAX_WORDS];
+
+        uint64_t seed = 0;
+        XXHash64 hasher = XXHash64::create(seed);
+
+        for (uint64_t m = 0; m < num_msgs; ++m) {
+            uint64_t base = offsets[m];
+            uint64_t target = dest_offsets[m];
+            uint64_t length = lengths[m];
+            uint64_t words = (length + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+            bool stage = verify && words <= COPY_MAX_WORDS;
+
+            for (uint64_t i = 0; i < words; ++i) {
+                uint64_t word = input[base + i];
+                uint64_t chunk = (length - i * sizeof(uint64_t) < sizeof(uint64_t)) ? length - i * sizeof(uint64_t) : sizeof(uint64_t);
+                hasher = hasher.add(hasher, word, chunk);
+                if (!verify) {
+                    dest[target + i] = word;
+                } else if (stage) {
+                    staging[i] = word;
+                }
+            }
+
+            HashResult hashResult = hasher.hash(hasher);
+            hasher = hashResult.xxh;
+            output[m] = hashResult.hash;
+
+            if (!verify) {
+                status[m] = COPY_OK;
+            } else if (!stage) {
+                status[m] = COPY_TOO_LONG;
+            } else if (hashResult.hash != expected[m]) {
+                status[m] = COPY_MISMATCH;
+            } else {
+                // commit - the staged words go out without touching input again
+                for (uint64_t i = 0; i < words; ++i) {
+                    dest[target + i] = staging[i];
+                }
+                status[m] = COPY_OK;
+            }
+        }
+    }
 }
\ No newline at end of file
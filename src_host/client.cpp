@@ -0,0 +1,164 @@
+#include "constants.h"
+#include "shm_ring.h"
+#include "xxhash64.h"
+#include <vector>
+#include <random>
+#include <ctime>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <iostream>
+
+/* Example replica process for the hashing daemon
+Submits random sized payloads with a window of requests in flight and checks every digest against the host reference,
+then a few payloads of up to the whole arena slice. Before that it checks the arena accounting on a private region.
+Start the daemon first (./daemon --cpu works without a card), then any number of these.
+*/
+
+/* The daemon drains a ring far faster than one client fills it, so edge cases of the client's arena accounting are
+checked against a private region instead - this process plays the daemon and decides when requests complete.
+*/
+struct fake_daemon {
+    std::string name;
+    void* ptr;
+    shm_header* hdr;
+
+    fake_daemon() : name(std::string(SHM_NAME) + "_check_" + std::to_string(getpid())), ptr(MAP_FAILED), hdr(nullptr) {
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) return;
+        if (ftruncate(fd, shm_region_size()) == 0) {
+            ptr = mmap(nullptr, shm_region_size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if (ptr == MAP_FAILED) return;
+        hdr = (shm_header*)ptr;
+        hdr->magic = SHM_MAGIC;
+        hdr->version = SHM_VERSION;
+        hdr->ready.store(1, std::memory_order_release);
+    }
+
+    ~fake_daemon() {
+        if (hdr) munmap(ptr, shm_region_size());
+        shm_unlink(name.c_str());
+    }
+
+    // hashes the requests of client c up to (not including) seq and publishes them
+    void complete(int c, uint64_t seq) {
+        shm_client_slot& slot = hdr->clients[c];
+        const uint8_t* arena = (const uint8_t*)ptr + shm_arena_offset();
+        for (uint64_t s = slot.completed.load(std::memory_order_relaxed); s < seq; ++s) {
+            shm_request& req = slot.ring[s % SHM_RING_SLOTS];
+            req.digest = XXHash64::hash(arena + req.offset, req.length, 0);
+        }
+        slot.tail.store(seq, std::memory_order_relaxed);
+        slot.completed.store(seq, std::memory_order_release);
+    }
+};
+
+// alloc + submit of a payload with its own contents, expected gets its digest (indexed by ticket)
+static bool submit_pattern(accel_client& c, uint64_t length, std::vector<uint64_t>& expected) {
+    uint8_t* p = (uint8_t*)c.alloc(length);
+    if (!p) return false;
+    memset(p, (int)(expected.size() + 1), length);
+    expected.push_back(XXHash64::hash(p, length, 0));
+    c.submit(length);
+    return true;
+}
+
+// edge cases of the arena accounting - returns the number of failed checks
+static uint64_t check_arena() {
+    fake_daemon daemon;
+    accel_client c;
+    if (!daemon.hdr || !c.connect(daemon.name)) return 1;
+    uint64_t failed = 0;
+    std::vector<uint64_t> expected;
+
+    // after the ring drained, two requests can be in flight again at once
+    submit_pattern(c, 8, expected);
+    daemon.complete(c.id(), 1);
+    submit_pattern(c, 100, expected);
+    if (!submit_pattern(c, 100, expected)) failed++;
+    daemon.complete(c.id(), c.stats().submitted);
+
+    // with the request ring full, every payload in flight still counts as in use
+    uint64_t first = expected.size();
+    while (c.stats().submitted - c.stats().completed < SHM_RING_SLOTS - 1 && submit_pattern(c, 3000, expected)) {
+    }
+    if (c.stats().submitted - c.stats().completed != SHM_RING_SLOTS - 1) failed++;
+    if (c.alloc(500000) != nullptr) failed++;     // ~750 KB are in flight, half the slice is not free
+    daemon.complete(c.id(), c.stats().submitted);
+
+    for (uint64_t t = 0; t < expected.size(); ++t) {
+        uint64_t digest;
+        if (t < first && t + SHM_RING_SLOTS < expected.size()) continue;     // descriptor reused since
+        if (!c.poll(t, &digest) || digest != expected[t]) failed++;
+    }
+    return failed;
+}
+
+int main(int argc, char** argv) {
+
+    uint64_t failed = check_arena();
+    std::cout << "Arena checks on a private region " << (failed ? "FAILED" : "passed") << std::endl;
+
+    uint64_t num_msgs = (argc > 1) ? strtoull(argv[1], nullptr, 10) : 100000;
+    uint64_t max_len = (argc > 2) ? strtoull(argv[2], nullptr, 10) : 512;
+    const uint64_t window = SHM_RING_SLOTS / 2;
+
+    accel_client client;
+    if (!client.connect()) {
+        std::cout << "Failed to attach to " << SHM_NAME << " - is the daemon running?" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "Attached as client " << client.id() << std::endl;
+
+    std::mt19937_64 rng(getpid());
+    std::vector<uint64_t> tickets(window), expected(window);
+    uint64_t mismatches = 0, bytes = 0;
+
+    timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (uint64_t i = 0; i < num_msgs + window; ++i) {
+        // retire the request submitted window iterations ago
+        if (i >= window) {
+            uint64_t k = i % window;
+            if (client.wait(tickets[k]) != expected[k]) mismatches++;
+        }
+        if (i >= num_msgs) continue;
+
+        uint64_t length = rng() % (max_len + 1);
+        uint8_t* payload;
+        while ((payload = (uint8_t*)client.alloc(length)) == nullptr) sched_yield();
+        for (uint64_t b = 0; b < length; ++b) {
+            payload[b] = (uint8_t)rng();
+        }
+        expected[i % window] = XXHash64::hash(payload, length, 0);
+        tickets[i % window] = client.submit(length);
+        bytes += length;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    // large payloads need most of the slice each, they only fit once the arena starts over at a slice boundary
+    const uint64_t large[] = {600 << 10, 700 << 10, SHM_ARENA_BYTES, 3 << 10, SHM_ARENA_BYTES - 8};
+    std::vector<uint8_t> big(SHM_ARENA_BYTES + 1);
+    for (uint8_t& b : big) {
+        b = (uint8_t)rng();
+    }
+    uint64_t digest;
+    for (uint64_t length : large) {
+        if (!client.hash(big.data(), length, &digest) || digest != XXHash64::hash(big.data(), length, 0)) mismatches++;
+    }
+    if (client.hash(big.data(), big.size(), &digest)) mismatches++;     // more than the slice is refused, not retried
+
+    shm_client_stats stats = client.stats();
+    std::cout << "Messages: " << stats.completed << ", bytes: " << stats.bytes << ", daemon batches: " << stats.batches << std::endl;
+    std::cout << "Throughput: " << num_msgs / secs << " msg/s, " << bytes / secs / (1 << 20) << " MiB/s" << std::endl;
+    if (mismatches || failed) {
+        std::cout << "TEST FAILED: " << mismatches << " digests differ from the host reference, " << failed << " arena checks failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "TEST PASSED" << std::endl;
+}
@@ -0,0 +1,198 @@
+#include "host.h"
+#include "constants.h"
+#include "backend.h"
+#include "shm_ring.h"
+#include <vector>
+#include <memory>
+#include <errno.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <string.h>
+#include <cstdint>
+#include <iostream>
+
+/* Hashing daemon: owns the device and serves every replica process on the machine
+
+Clients attach through the shared memory region described in shm_ring.h. Each round the daemon takes
+up to SHM_CLIENT_QUANTUM requests from every client, starting at a different client each round, and
+hashes all of them in one kernel invocation. With --cpu the host reference stands in for the card.
+*/
+
+static volatile sig_atomic_t stop = 0;
+
+static void on_signal(int) {
+    stop = 1;
+}
+
+// a client that died without disconnecting would hold its slot forever
+static void reclaim_dead_clients(shm_header* hdr) {
+    for (int c = 0; c < SHM_MAX_CLIENTS; ++c) {
+        shm_client_slot& slot = hdr->clients[c];
+        if (slot.in_use.load(std::memory_order_acquire) != 1 || slot.pid == 0) continue;
+        if (kill(slot.pid, 0) == -1 && errno == ESRCH) {
+            std::cout << "Client " << c << " (pid " << slot.pid << ") went away, reclaiming its slot" << std::endl;
+            shm_reset_slot(slot);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+
+    if (argc != 2) {
+        std::cout << "Usage: " << argv[0] << " <XCLBIN File | --cpu>" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    /*====================================================SHARED MEMORY===============================================================*/
+
+    /* never take the name over from a running daemon - the daemon holds a lock on SHM_LOCK_NAME for as long as it
+    runs, and the kernel drops it when the process dies; with the lock held any region found is left over, and a
+    region is only created under the lock, so its owner is known before anybody can see it
+    */
+    int lock_fd = shm_open(SHM_LOCK_NAME, O_CREAT | O_RDWR, 0666);
+    if (lock_fd < 0 || flock(lock_fd, LOCK_EX | LOCK_NB) != 0) {
+        if (errno == EWOULDBLOCK) {
+            std::cout << SHM_NAME << " is served by another daemon" << std::endl;
+        } else {
+            std::cout << "Failed to lock " << SHM_LOCK_NAME << ": " << strerror(errno) << std::endl;
+        }
+        return EXIT_FAILURE;
+    }
+    if (shm_unlink(SHM_NAME) == 0) std::cout << "Removed stale " << SHM_NAME << std::endl;
+    int fd = shm_open(SHM_NAME, O_CREAT | O_EXCL | O_RDWR, 0666);
+    if (fd < 0 || ftruncate(fd, shm_region_size()) != 0) {
+        std::cout << "Failed to create shared memory " << SHM_NAME << ": " << strerror(errno) << std::endl;
+        return EXIT_FAILURE;
+    }
+    void* ptr = mmap(nullptr, shm_region_size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        std::cout << "Failed to map shared memory: " << strerror(errno) << std::endl;
+        shm_unlink(SHM_NAME);
+        return EXIT_FAILURE;
+    }
+
+    // ftruncate hands out zeroed pages, which is the initial state of every slot
+    shm_header* hdr = (shm_header*)ptr;
+    hdr->magic = SHM_MAGIC;
+    hdr->version = SHM_VERSION;
+    uint64_t* arena = (uint64_t*)((uint8_t*)ptr + shm_arena_offset());
+
+    /*====================================================BACKEND===============================================================*/
+
+    std::string binaryFile = argv[1];
+    cl::Context context;
+    cl::CommandQueue q;
+    cl::Program program;
+    std::unique_ptr<hash_backend> backend;
+
+    if (binaryFile == "--cpu") {
+        backend.reset(new cpu_backend(arena));
+    } else {
+        cl::Device device;
+        program = program_xil_device(binaryFile, context, q, &device);
+
+        // arena pages and the dispatch loop live next to the card - clients fault the pages in on that node
+        int node = find_device_numa_node(device);
+        bool bound = numa_bind_buffer(arena, (size_t)SHM_MAX_CLIENTS * SHM_ARENA_BYTES, node);
+        bool pinned = pin_thread_to_node(node);
+        std::cout << "Device NUMA node: " << node << (bound ? ", arena bound" : "") << (pinned ? ", dispatcher pinned" : "") << std::endl;
+        // the whole arena is registered once - clients' payloads are hashed where they wrote them
+        backend.reset(new device_backend(context, q, program, arena, (size_t)SHM_MAX_CLIENTS * SHM_ARENA_BYTES, SHM_MAX_BATCH));
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    hdr->ready.store(1, std::memory_order_release);
+    std::cout << "Serving " << SHM_NAME << " with the " << backend->name() << " backend" << std::endl;
+
+    /*====================================================DISPATCH LOOP===============================================================*/
+
+    std::vector<uint64_t> offsets(SHM_MAX_BATCH), lengths(SHM_MAX_BATCH), digests(SHM_MAX_BATCH);
+    std::vector<uint32_t> owner(SHM_MAX_BATCH);
+    std::vector<uint64_t> first_seq(SHM_MAX_CLIENTS), taken(SHM_MAX_CLIENTS), next(SHM_MAX_CLIENTS);
+    uint64_t total_batches = 0, total_msgs = 0, idle = 0;
+    int rr = 0;
+
+    while (!stop) {
+        size_t n = 0;
+
+        // gather - at most one quantum per client, round robin start so nobody is always first
+        for (int k = 0; k < SHM_MAX_CLIENTS; ++k) {
+            int c = (rr + k) % SHM_MAX_CLIENTS;
+            shm_client_slot& slot = hdr->clients[c];
+            taken[c] = 0;
+            uint32_t state = slot.in_use.load(std::memory_order_acquire);
+            if (state == 2) {
+                shm_reset_slot(slot);     // the client disconnected, with nothing in flight
+                continue;
+            }
+            if (state != 1) continue;
+
+            uint64_t tail = slot.tail.load(std::memory_order_relaxed);
+            uint64_t head = slot.head.load(std::memory_order_acquire);
+            uint64_t take = (head - tail < SHM_CLIENT_QUANTUM) ? head - tail : SHM_CLIENT_QUANTUM;
+
+            uint64_t slice_begin = (uint64_t)c * SHM_ARENA_BYTES;
+            for (uint64_t j = 0; j < take; ++j) {
+                const shm_request& req = slot.ring[(tail + j) % SHM_RING_SLOTS];
+                // a client may only point into its own slice, anything else is hashed as an empty message -
+                // checked without adding offset and length, the sum can wrap
+                bool valid = req.offset % sizeof(uint64_t) == 0 && req.offset >= slice_begin && req.length <= SHM_ARENA_BYTES &&
+                             req.offset - slice_begin <= SHM_ARENA_BYTES - req.length;
+                offsets[n] = (valid ? req.offset : slice_begin) / sizeof(uint64_t);
+                lengths[n] = valid ? req.length : 0;
+                owner[n] = c;
+                n++;
+            }
+            if (take) {
+                first_seq[c] = tail;
+                taken[c] = take;
+                slot.tail.store(tail + take, std::memory_order_relaxed);
+            }
+        }
+        rr = (rr + 1) % SHM_MAX_CLIENTS;
+
+        if (n == 0) {
+            if (++idle % 4096 == 0) reclaim_dead_clients(hdr);
+            if (idle > 1024) usleep(50);
+            continue;
+        }
+        idle = 0;
+
+        backend->hash_batch(offsets.data(), lengths.data(), digests.data(), n);
+
+        // complete - digests first, then one release store per client
+        next = first_seq;
+        for (size_t i = 0; i < n; ++i) {
+            shm_client_slot& slot = hdr->clients[owner[i]];
+            slot.ring[next[owner[i]]++ % SHM_RING_SLOTS].digest = digests[i];
+            slot.bytes.fetch_add(lengths[i], std::memory_order_relaxed);
+        }
+        for (int c = 0; c < SHM_MAX_CLIENTS; ++c) {
+            if (!taken[c]) continue;
+            hdr->clients[c].batches.fetch_add(1, std::memory_order_relaxed);
+            hdr->clients[c].completed.store(first_seq[c] + taken[c], std::memory_order_release);
+        }
+
+        total_batches++;
+        total_msgs += n;
+    }
+
+    /*====================================================SHUTDOWN===============================================================*/
+
+    std::cout << "Batches: " << total_batches << ", messages: " << total_msgs;
+    if (total_batches) std::cout << ", avg batch: " << (double)total_msgs / total_batches;
+    std::cout << std::endl;
+    for (int c = 0; c < SHM_MAX_CLIENTS; ++c) {
+        shm_client_slot& slot = hdr->clients[c];
+        if (slot.in_use.load(std::memory_order_acquire) != 1) continue;
+        std::cout << "Client " << c << " (pid " << slot.pid << "): completed " << slot.completed.load()
+                  << ", bytes " << slot.bytes.load() << ", batches " << slot.batches.load() << std::endl;
+    }
+
+    hdr->ready.store(0, std::memory_order_release);
+    munmap(ptr, shm_region_size());
+    shm_unlink(SHM_NAME);
+    close(lock_fd);     // after the unlink, so the next daemon finds no region
+}
@@ -1,5 +1,11 @@
 #include "host.h"
 #include "constants.h"
+#include "xxhash64.h"
+#include "backend.h"
+#include "page_cache.h"
+#include "ring.h"
+#include "dedup.h"
+#include "copy.h"
 #include <vector> 
 #include <random>
 #include <assert.h>
@@ -8,186 +14,6 @@
 #include <cstdint>
 #include <iostream>
 
-struct XXHash64 {
-    
-    static const uint64_t MaxBufferSize = 31 + 1;
-    static const uint64_t Prime1 = 11400714785074694791ULL;
-    static const uint64_t Prime2 = 14029467366897019727ULL;
-    static const uint64_t Prime3 =  1609587929392839161ULL;
-    static const uint64_t Prime4 =  9650029242287828579ULL;
-    static const uint64_t Prime5 =  2870177450012600261ULL;
-
-    uint64_t state[4];
-    unsigned char buffer[MaxBufferSize];
-    uint64_t bufferSize;
-    uint64_t totalLength;
-
-    //creates and initializes a hasher object
-    static XXHash64 create(uint64_t seed) {
-        XXHash64 xxh;
-        xxh.state[0] = seed + Prime1 + Prime2;
-        xxh.state[1] = seed + Prime2;
-        xxh.state[2] = seed;
-        xxh.state[3] = seed - Prime1;
-        xxh.bufferSize = 0;
-        xxh.totalLength = 0;
-        return xxh;
-    }
-
-    // adds data to hasher object
-    bool add(const void* input, uint64_t length) {
-        // Check for no data
-        if (!input || length == 0) return false;
-
-        totalLength += length;
-        // Byte-wise access
-        const unsigned char* data = (const unsigned char*)input;
-
-        // Calculate how much space is left in the buffer
-        uint64_t spaceLeft = MaxBufferSize - bufferSize;
-
-        // If all data fits into the remaining buffer space
-        if (length <= spaceLeft) {
-            for (uint64_t i = 0; i < length; ++i) {
-                buffer[bufferSize + i] = data[i];
-            }
-            bufferSize += length;
-            return true;
-        }
-
-        // Fill up the buffer first if it's partially filled
-        uint64_t initialCopyLength = spaceLeft;
-        for (uint64_t i = 0; i < initialCopyLength; ++i) {
-            buffer[bufferSize + i] = data[i];
-        }
-        bufferSize += initialCopyLength;
-
-        // Process the filled buffer
-        process(buffer, state[0], state[1], state[2], state[3]);
-        bufferSize = 0; // Reset buffer after processing
-
-        // Process chunks of 32 bytes directly from input data
-        uint64_t processedLength = initialCopyLength;
-        uint64_t remainingLength = length - processedLength;
-        while (remainingLength >= 32) {
-            process(&data[processedLength], state[0], state[1], state[2], state[3]);
-            processedLength += 32;
-            remainingLength -= 32;
-        }
-
-        // Copy any remaining bytes to the buffer
-        for (uint64_t i = 0; i < remainingLength; ++i) {
-            buffer[i] = data[processedLength + i];
-        }
-        bufferSize = remainingLength;
-
-        return true;
-    }
-
-    // computes hash 
-    uint64_t hash() const {
-        uint64_t result;
-        if (totalLength >= MaxBufferSize) {
-            result = rotateLeft(state[0],  1) +
-                    rotateLeft(state[1],  7) +
-                    rotateLeft(state[2], 12) +
-                    rotateLeft(state[3], 18);
-            result = (result ^ processSingle(0, state[0])) * Prime1 + Prime4;
-            result = (result ^ processSingle(0, state[1])) * Prime1 + Prime4;
-            result = (result ^ processSingle(0, state[2])) * Prime1 + Prime4;
-            result = (result ^ processSingle(0, state[3])) * Prime1 + Prime4;
-        } else {
-            // Internal state wasn't set in add(), therefore original seed is still stored in state2
-            result = state[2] + Prime5;
-        }
-
-        result += totalLength;
-
-        // Process remaining bytes in temporary buffer
-        uint64_t dataIndex = 0;  // Use dataIndex to access buffer elements
-
-        // At least 8 bytes left? => Process 8 bytes per step
-        while (dataIndex + 8 <= bufferSize) {
-            uint64_t dataValue = 0;
-            for (int i = 0; i < 8; i++) {
-                dataValue |= ((uint64_t)buffer[dataIndex + i]) << (i * 8);
-            }
-            result = rotateLeft(result ^ processSingle(0, dataValue), 27) * Prime1 + Prime4;
-            dataIndex += 8;
-        }
-
-        // 4 bytes left? => Process those
-        if (dataIndex + 4 <= bufferSize) {
-            uint32_t dataValue = 0;
-            for (int i = 0; i < 4; i++) {
-                dataValue |= ((uint32_t)buffer[dataIndex + i]) << (i * 8);
-            }
-            result = rotateLeft(result ^ (dataValue * Prime1), 23) * Prime2 + Prime3;
-            dataIndex += 4;
-        }
-
-        // Take care of remaining 0..3 bytes, process 1 byte per step
-        while (dataIndex < bufferSize) {
-            result = rotateLeft(result ^ (buffer[dataIndex++] * Prime5), 11) * Prime1;
-        }
-
-        // Mix bits
-        result ^= result >> 33;
-        result *= Prime2;
-        result ^= result >> 29;
-        result *= Prime3;
-        result ^= result >> 32;
-
-        return result;
-    }
-
-    // not used by ubft
-
-    // static uint64_t hash(const void* input, uint64_t length, uint64_t seed) {
-    //     XXHash64 hasher = XXHash64::create(seed);
-    //     hasher.add(input, length);
-    //     return hasher.hash();
-    // }
-
-    // printer function to print state of hasher object - Helpful for debugging
-
-    // void printXXHash64(const struct XXHash64 xxh) {
-    //         // Print state array
-    //     printf("State values from host:\n");
-    //     for (int i = 0; i < 4; ++i) {
-    //         printf("state[%d] = %llu\n", i, xxh.state[i]);
-    //     }
-
-    //     // Print buffer values
-    //     printf("\nBuffer values:\n");
-    //     for (uint64_t i = 0; i < xxh.bufferSize; ++i) {
-    //         printf("buffer[%llu] = %u\n", i, xxh.buffer[i]);
-    //     }
-
-    //     // Print bufferSize and totalLength
-    //     printf("\nBuffer size: %llu\n", xxh.bufferSize);
-    //     printf("Total length: %llu\n", xxh.totalLength);
-    // }
-
-    private:
-
-        static inline uint64_t rotateLeft(uint64_t x, unsigned char bits) {
-            return (x << bits) | (x >> (64 - bits));
-        }
-
-        static inline uint64_t processSingle(uint64_t previous, uint64_t input) {
-            return rotateLeft(previous + input * Prime2, 31) * Prime1;
-        }
-
-        static inline void process(const void* data, uint64_t& state0, uint64_t& state1, uint64_t& state2, uint64_t& state3) {
-            const uint64_t* block = (const uint64_t*) data;
-            state0 = processSingle(state0, block[0]);
-            state1 = processSingle(state1, block[1]);
-            state2 = processSingle(state2, block[2]);
-            state3 = processSingle(state3, block[3]);
-        } 
-};
-
 
 int main(int argc, char** argv) {
 
@@ -206,30 +32,17 @@ int main(int argc, char** argv) {
     cl::Kernel krnl1, krnl2;
     cl::CommandQueue q;
     
-    auto devices = get_xil_devices();
-    auto fileBuf = read_binary_file(binaryFile);
-    cl::Program::Binaries bins{{fileBuf.data(), fileBuf.size()}};
-    bool valid_device = false;
-    for (unsigned int i = 0; i < devices.size(); i++) {
-        auto device = devices[i];
-        OCL_CHECK(err, context = cl::Context(device, nullptr, nullptr, nullptr, &err));
-        OCL_CHECK(err, q = cl::CommandQueue(context, device, 0, &err));
-        std::cout << "Trying to program device[" << i << "]: " << device.getInfo<CL_DEVICE_NAME>() << std::endl;
-        cl::Program program(context, {device}, bins, nullptr, &err);
-        if (err != CL_SUCCESS) {
-            std::cout << "Failed to program device[" << i << "] with xclbin file!\n";
-        } else {
-            std::cout << "Device[" << i << "]: program successful!\n";
-            std::cout << "Setting CU(s) up..." << std::endl; 
-            OCL_CHECK(err, krnl1 = cl::Kernel(program, "krnl", &err));
-            valid_device = true;
-            break; // we break because we found a valid device
-        }
-    }
-    if (!valid_device) {
-        std::cout << "Failed to program any device found, exit!\n";
-        exit(EXIT_FAILURE);
-    }
+    cl::Device device;
+    cl::Program program = program_xil_device(binaryFile, context, q, &device);
+
+    // staging buffers and this thread go to the node the card hangs off
+    int local_node = find_device_numa_node(device);
+    staging_numa_node() = local_node;
+    bool pinned = pin_thread_to_node(local_node);
+    std::cout << "Device NUMA node: " << local_node << (pinned ? " (thread pinned)" : "") << std::endl;
+
+    std::cout << "Setting CU(s) up..." << std::endl; 
+    OCL_CHECK(err, krnl1 = cl::Kernel(program, "krnl", &err));
 
     /*====================================================INIT INPUT/OUTPUT VECTORS===============================================================*/
 
@@ -237,6 +50,9 @@ int main(int argc, char** argv) {
     // My implementation is tested on uint64_t vector of size 3
     std::vector<uint64_t, aligned_allocator<uint64_t> > input(3);
     std::vector<uint64_t, aligned_allocator<uint64_t> > hash_hw(1);
+    // krnl hashes a batch of messages - here a single message of 3 words starting at word 0
+    std::vector<uint64_t, aligned_allocator<uint64_t> > offsets = {0};
+    std::vector<uint64_t, aligned_allocator<uint64_t> > lengths = {sizeof(uint64_t) * 3};
     uint64_t *hash_sw = (uint64_t*) malloc(sizeof(uint64_t) * 1);
 
     /*====================================================SW VERIFICATION===============================================================*/
@@ -269,13 +85,18 @@ int main(int argc, char** argv) {
 
     //xxhash config
     OCL_CHECK(err, cl::Buffer buffer_input(context, CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY, sizeof(uint64_t) * 3, input.data(), &err)); 
+    OCL_CHECK(err, cl::Buffer buffer_offsets(context, CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY, sizeof(uint64_t) * 1, offsets.data(), &err)); 
+    OCL_CHECK(err, cl::Buffer buffer_lengths(context, CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY, sizeof(uint64_t) * 1, lengths.data(), &err)); 
 
     /* OUTPUT BUFFERS */
     OCL_CHECK(err, cl::Buffer buffer_output(context, CL_MEM_USE_HOST_PTR | CL_MEM_WRITE_ONLY, sizeof(uint64_t) * 1, hash_hw.data(), &err)); 
 
     /* SETTING INPUT PARAMETERS */
     OCL_CHECK(err, err = krnl1.setArg(0, buffer_input));
-    OCL_CHECK(err, err = krnl1.setArg(1, buffer_output));
+    OCL_CHECK(err, err = krnl1.setArg(1, buffer_offsets));
+    OCL_CHECK(err, err = krnl1.setArg(2, buffer_lengths));
+    OCL_CHECK(err, err = krnl1.setArg(3, buffer_output));
+    OCL_CHECK(err, err = krnl1.setArg(4, (uint64_t)1));
 
 
 
@@ -283,7 +104,7 @@ int main(int argc, char** argv) {
     /* HOST -> DEVICE DATA TRANSFER*/
     std::cout << "HOST -> DEVICE" << std::endl; 
     htod = clock(); 
-    OCL_CHECK(err, err = q.enqueueMigrateMemObjects({buffer_input}, 0 /* 0 means from host*/));
+    OCL_CHECK(err, err = q.enqueueMigrateMemObjects({buffer_input, buffer_offsets, buffer_lengths}, 0 /* 0 means from host*/));
     q.finish();
     htod = clock() - htod; 
     
@@ -305,5 +126,209 @@ int main(int argc, char** argv) {
     /*====================================================VERIFICATION & TIMING===============================================================*/
 
     std::cout << "Hash from krnl: " << hash_hw[0] << std::endl;
+
+    /*====================================================INCREMENTAL CHECKPOINT===============================================================*/
+
+    // only the pages written since the last checkpoint go to the kernel
+    std::vector<uint64_t, aligned_allocator<uint64_t> > state(CHECKPOINT_PAGES * HASH_PAGE_BYTES / sizeof(uint64_t));
+    std::mt19937_64 rng(seed);
+    for (size_t i = 0; i < state.size(); ++i) {
+        state[i] = rng();
+    }
+    device_backend state_krnl(context, q, program, state.data(), state.size() * sizeof(uint64_t), CHECKPOINT_PAGES);
+    page_hash_cache cache(state.data(), state.size() * sizeof(uint64_t), state_krnl);
+    bool soft_dirty = cache.clear_soft_dirty();
+
+    comp = clock();
+    uint64_t root = cache.checkpoint();
+    comp = clock() - comp;
+    std::cout << "Checkpoint (full): " << cache.pages_hashed() << " pages, " << comp << " ticks, root " << root << std::endl;
+
+    // a few scattered writes, some of them crossing a page boundary
+    size_t writes[] = {17, 511, 512, 100000, state.size() - 1};
+    for (size_t w : writes) {
+        state[w] ^= 0xdeadbeef;
+        if (!soft_dirty) cache.mark_dirty(w * sizeof(uint64_t), sizeof(uint64_t));
+    }
+    memset((uint8_t*)state.data() + 3 * HASH_PAGE_BYTES - 100, 0, 200);
+    if (!soft_dirty) cache.mark_dirty(3 * HASH_PAGE_BYTES - 100, 200);
+    if (soft_dirty && !cache.scan_soft_dirty()) {
+        std::cout << "Soft-dirty scan failed, marking everything" << std::endl;
+        cache.mark_dirty(0, state.size() * sizeof(uint64_t));
+    }
+
+    comp = clock();
+    root = cache.checkpoint();
+    comp = clock() - comp;
+    std::cout << "Checkpoint (incremental, " << (soft_dirty ? "soft-dirty" : "marked") << "): " << cache.pages_hashed()
+              << " pages, " << comp << " ticks, root " << root << std::endl;
+
+    // reference: rebuild the whole tree on the host
+    cpu_backend state_sw(state.data());
+    page_hash_cache reference(state.data(), state.size() * sizeof(uint64_t), state_sw);
+    uint64_t root_sw = reference.checkpoint();
+    std::cout << "Checkpoint root from host: " << root_sw << std::endl;
+
+    /*====================================================RING INGESTION===============================================================*/
+
+    // records go in the way the transport delivers them, starting close to the end so that they wrap around
+    std::vector<uint64_t, aligned_allocator<uint64_t> > ring(RING_WORDS);
+    uint64_t ring_head = RING_WORDS - 37, ring_tail = ring_head;
+    std::vector<uint64_t> record_sw;
+    std::vector<uint8_t> payload;
+    for (;;) {
+        payload.resize(rng() % 300);
+        for (size_t b = 0; b < payload.size(); ++b) {
+            payload[b] = (uint8_t)rng();
+        }
+        if (record_sw.size() == RING_MAX_RECORDS || !ring_push(ring.data(), RING_WORDS, ring_head, ring_tail, payload.data(), payload.size())) break;
+        record_sw.push_back(XXHash64::hash(payload.data(), payload.size(), 0));
+    }
+
+    device_ring ring_krnl(context, q, program, ring.data(), RING_WORDS, RING_MAX_RECORDS);
+    std::vector<uint64_t> record_hw(RING_MAX_RECORDS);
+    uint64_t ring_next = 0;
+    comp = clock();
+    uint64_t records = ring_krnl.hash_records(ring_head, ring_tail, record_hw.data(), &ring_next);
+    comp = clock() - comp;
+    std::cout << "Ring: " << records << " records (" << (ring_tail - ring_head) * sizeof(uint64_t) << " bytes) hashed in place, "
+              << comp << " ticks" << std::endl;
+
+    bool ring_match = (records == record_sw.size()) && (ring_next == ring_tail);
+    for (uint64_t i = 0; ring_match && i < records; ++i) {
+        ring_match = (record_hw[i] == record_sw[i]);
+    }
+    std::cout << "Ring digests " << (ring_match ? "match" : "DO NOT match") << " the host" << std::endl;
+
+    /*====================================================DEDUP INDEX===============================================================*/
+
+    // 64 byte messages drawn from a small set of payloads, so that plenty of them repeat
+    std::vector<uint64_t, aligned_allocator<uint64_t> > dedup_payloads(DEDUP_TEST_MSGS / 4 * 8);
+    for (size_t i = 0; i < dedup_payloads.size(); ++i) {
+        dedup_payloads[i] = rng();
+    }
+    std::vector<uint64_t> dedup_offsets(DEDUP_TEST_MSGS), dedup_lengths(DEDUP_TEST_MSGS, 64);
+    for (size_t i = 0; i < DEDUP_TEST_MSGS; ++i) {
+        dedup_offsets[i] = (rng() % (DEDUP_TEST_MSGS / 4)) * 8;
+    }
+    std::vector<uint64_t> dedup_seeds = {XXHash64::hash(&dedup_payloads[dedup_offsets[0]], 64, 0), XXHash64::hash(&dedup_payloads[8], 64, 0)};
+
+    // a quarter of the messages per kernel call, so the batch is split and the index carries over between calls
+    device_dedup dedup_krnl(context, q, program, dedup_payloads.data(), dedup_payloads.size() * sizeof(uint64_t), DEDUP_TEST_MSGS / 4);
+    dedup_krnl.seed(dedup_seeds);
+    std::vector<uint32_t> dedup_flags(DEDUP_TEST_MSGS);
+    std::vector<uint64_t> dedup_new(DEDUP_TEST_MSGS);
+    comp = clock();
+    size_t fresh = dedup_krnl.hash_batch(dedup_offsets.data(), dedup_lengths.data(), DEDUP_TEST_MSGS, dedup_flags.data(), dedup_new.data());
+    comp = clock() - comp;
+    std::cout << "Dedup: " << DEDUP_TEST_MSGS - fresh << " of " << DEDUP_TEST_MSGS << " messages seen before, " << comp << " ticks" << std::endl;
+
+    // same sequence through the host reference
+    dedup_index_sw dedup_sw;
+    for (uint64_t d : dedup_seeds) {
+        dedup_sw.lookup_insert(d);
+    }
+    bool dedup_match = true;
+    size_t k = 0;
+    for (size_t i = 0; i < DEDUP_TEST_MSGS; ++i) {
+        uint64_t digest = XXHash64::hash(&dedup_payloads[dedup_offsets[i]], 64, 0);
+        uint32_t flag = dedup_sw.lookup_insert(digest);
+        if (flag != dedup_flags[i]) dedup_match = false;
+        if (!(flag & DEDUP_SEEN_FLAG) && (k >= fresh || dedup_new[k++] != digest)) dedup_match = false;
+    }
+    std::vector<uint64_t> dedup_image = dedup_krnl.snapshot();
+    dedup_match = dedup_match && (k == fresh) && (dedup_image == dedup_sw.index);
+    dedup_krnl.clear();
+    dedup_match = dedup_match && (dedup_krnl.snapshot() == dedup_index_sw().index);
+
+    // the image goes back in as it came out, an image with a clock hand out of range is refused
+    dedup_match = dedup_match && dedup_krnl.seed(dedup_image.data()) && (dedup_krnl.snapshot() == dedup_image);
+    dedup_image[DEDUP_HAND_BASE] = DEDUP_WAYS;
+    dedup_match = dedup_match && !dedup_krnl.seed(dedup_image.data());
+    std::cout << "Dedup flags and index " << (dedup_match ? "match" : "DO NOT match") << " the host" << std::endl;
+
+    /*====================================================COPY AND HASH===============================================================*/
+
+    // messages go to a log while they are hashed - every 16th one carries a wrong expected digest and must not be logged,
+    // message 1 is longer than COPY_MAX_WORDS and cannot be verified
+    std::vector<uint64_t, aligned_allocator<uint64_t> > copy_src(COPY_TEST_MSGS * COPY_MAX_WORDS / 4), copy_log(copy_src.size(), 0);
+    std::vector<uint64_t, aligned_allocator<uint64_t> > copy_log_sw(copy_src.size(), 0);
+    for (size_t i = 0; i < copy_src.size(); ++i) {
+        copy_src[i] = rng();
+    }
+    std::vector<uint64_t> copy_offsets(COPY_TEST_MSGS), copy_lengths(COPY_TEST_MSGS), copy_dest(COPY_TEST_MSGS), copy_expected(COPY_TEST_MSGS);
+    uint64_t copy_pos = 0;
+    for (size_t i = 0; i < COPY_TEST_MSGS; ++i) {
+        copy_lengths[i] = (i == 1) ? (COPY_MAX_WORDS + 1) * sizeof(uint64_t) + 3 : rng() % (COPY_MAX_WORDS / 4 * sizeof(uint64_t));
+        copy_offsets[i] = i * COPY_MAX_WORDS / 4;
+        copy_dest[i] = copy_pos;
+        copy_pos += (copy_lengths[i] + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+        copy_expected[i] = XXHash64::hash(&copy_src[copy_offsets[i]], copy_lengths[i], 0) ^ (i % 16 == 0);
+    }
+
+    // a quarter of the messages per kernel call, so the batch is split
+    device_copy copy_krnl(context, q, program, copy_src.data(), copy_src.size() * sizeof(uint64_t),
+                          copy_log.data(), copy_log.size() * sizeof(uint64_t), COPY_TEST_MSGS / 4);
+    std::vector<uint64_t> copy_digests(COPY_TEST_MSGS), copy_digests_sw(COPY_TEST_MSGS);
+    std::vector<uint32_t> copy_status(COPY_TEST_MSGS), copy_status_sw(COPY_TEST_MSGS);
+    comp = clock();
+    copy_krnl.copy_batch(copy_offsets.data(), copy_lengths.data(), copy_dest.data(), copy_expected.data(), COPY_TEST_MSGS, true,
+                         copy_digests.data(), copy_status.data());
+    comp = clock() - comp;
+    copy_and_hash_sw(copy_src.data(), copy_offsets.data(), copy_lengths.data(), copy_log_sw.data(), copy_dest.data(), copy_expected.data(),
+                     copy_digests_sw.data(), copy_status_sw.data(), COPY_TEST_MSGS, true);
+
+    size_t committed = std::count(copy_status.begin(), copy_status.end(), (uint32_t)COPY_OK);
+    bool copy_match = (copy_digests == copy_digests_sw) && (copy_status == copy_status_sw) && (copy_log == copy_log_sw) &&
+                      (copy_status[1] == COPY_TOO_LONG);
+    std::cout << "Copy and hash: " << committed << " of " << COPY_TEST_MSGS << " messages verified and logged, " << comp << " ticks" << std::endl;
+
+    // without verify every message is logged, the long one included
+    copy_krnl.copy_batch(copy_offsets.data(), copy_lengths.data(), copy_dest.data(), nullptr, COPY_TEST_MSGS, false,
+                         copy_digests.data(), copy_status.data());
+    copy_and_hash_sw(copy_src.data(), copy_offsets.data(), copy_lengths.data(), copy_log_sw.data(), copy_dest.data(), copy_expected.data(),
+                     copy_digests_sw.data(), copy_status_sw.data(), COPY_TEST_MSGS, false);
+    copy_match = copy_match && (copy_digests == copy_digests_sw) && (copy_status == copy_status_sw) && (copy_log == copy_log_sw) &&
+                 (std::count(copy_status.begin(), copy_status.end(), (uint32_t)COPY_OK) == COPY_TEST_MSGS);
+    std::cout << "Copy digests, status and log " << (copy_match ? "match" : "DO NOT match") << " the host" << std::endl;
+
+    /*====================================================NUMA LOCAL VS REMOTE===============================================================*/
+
+    int remote_node = (local_node >= 0) ? numa_remote_node(local_node) : -1;
+    if (remote_node >= 0) {
+        int nodes[2] = {local_node, remote_node};
+        const char* names[2] = {"local", "remote"};
+        size_t num_bench = NUMA_BENCH_BYTES / NUMA_BENCH_MSG_BYTES;
+        std::vector<uint64_t> bench_offsets(num_bench), bench_lengths(num_bench, NUMA_BENCH_MSG_BYTES), bench_digests(num_bench);
+        for (size_t i = 0; i < num_bench; ++i) {
+            bench_offsets[i] = i * NUMA_BENCH_MSG_BYTES / sizeof(uint64_t);
+        }
+        for (int k = 0; k < 2; ++k) {
+            staging_numa_node() = nodes[k];
+            std::vector<uint64_t, aligned_allocator<uint64_t> > staging(NUMA_BENCH_BYTES / sizeof(uint64_t), 1);
+            // a failed bind leaves the pages wherever the kernel put them - that run would measure nothing
+            if (numa_node_of(staging.data()) != nodes[k] || numa_node_of(staging.data() + staging.size() - 1) != nodes[k]) {
+                std::cout << "Staging on " << names[k] << " node " << nodes[k] << ": pages not on that node, skipped" << std::endl;
+                continue;
+            }
+            device_backend bench_krnl(context, q, program, staging.data(), NUMA_BENCH_BYTES, num_bench);
+
+            timespec start, end;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            bench_krnl.hash_batch(bench_offsets.data(), bench_lengths.data(), bench_digests.data(), num_bench);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+            std::cout << "Staging on " << names[k] << " node " << nodes[k] << ": " << NUMA_BENCH_BYTES / secs / (1 << 20) << " MiB/s" << std::endl;
+        }
+        staging_numa_node() = local_node;
+    } else {
+        std::cout << "Single NUMA node (or node of the card unknown, or no other node allowed), skipping local vs. remote benchmark" << std::endl;
+    }
+
+    /*====================================================RESULT===============================================================*/
+
+    bool match = (hash_hw[0] == hashResult) && (root == root_sw) && ring_match && dedup_match && copy_match;
+    std::cout << (match ? "TEST PASSED" : "TEST FAILED") << std::endl;
     free(hash_sw);
+    return match ? EXIT_SUCCESS : EXIT_FAILURE;
 }
\ No newline at end of file